@@ -89,6 +89,99 @@ pub trait VideoEncoder {
     fn flush(&mut self) -> Result<Option<VideoEncoderOutput<Self::RawVideoFrame>>, Self::Error>;
 }
 
+/// A free list of buffers for encoded frames. Encoders that implement [`PipelinedVideoEncoder`]
+/// take their output buffers from one of these, and callers hand the buffers back once they're
+/// done with them. After a few frames, every output buffer is a recycled one and no more
+/// allocations are needed.
+#[derive(Default)]
+pub struct EncodedVideoFramePool {
+    buffers: Vec<Vec<u8>>,
+}
+
+impl EncodedVideoFramePool {
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    /// The number of buffers that are available for reuse.
+    pub fn len(&self) -> usize {
+        self.buffers.len()
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.buffers.is_empty()
+    }
+
+    /// Returns an empty buffer with room for at least `capacity` bytes. A recycled buffer is used
+    /// if there is one.
+    pub fn take(&mut self, capacity: usize) -> Vec<u8> {
+        match self.buffers.pop() {
+            Some(mut buf) => {
+                buf.reserve(capacity);
+                buf
+            }
+            None => Vec::with_capacity(capacity),
+        }
+    }
+
+    /// Makes the frame's buffer available for reuse.
+    pub fn recycle(&mut self, frame: EncodedVideoFrame) {
+        let mut buf = frame.data;
+        buf.clear();
+        self.buffers.push(buf);
+    }
+}
+
+/// Extends [`VideoEncoder`] with an API that decouples input from output and recycles buffers.
+///
+/// Frames are submitted without waiting on the encoded output, so the caller can keep the
+/// encoder's lookahead filled and collect output whenever it's convenient. Once the caller is done
+/// with an encoded frame, it should be passed to [`recycle`](Self::recycle) so that its buffer can
+/// be reused. Raw frames are handed back in the output just like with [`VideoEncoder::encode`], at
+/// which point the caller can return them to whatever pool they came from.
+///
+/// Typical usage should look like this:
+///
+/// ```
+/// # use av_traits::{EncodedFrameType, PipelinedVideoEncoder, RawVideoFrame};
+/// fn encode<S, E>(mut source: S, mut encoder: E) -> Result<(), E::Error>
+///     where S: Iterator<Item = Box<dyn RawVideoFrame<u8>>>,
+///     E: PipelinedVideoEncoder<RawVideoFrame = Box<dyn RawVideoFrame<u8>>>
+/// {
+///     while let Some(frame) = source.next() {
+///         encoder.submit(frame, EncodedFrameType::Auto)?;
+///         while let Some(output) = encoder.receive()? {
+///             // do something with output
+///             encoder.recycle(output.encoded_frame);
+///         }
+///     }
+///
+///     encoder.finish()?;
+///     while let Some(output) = encoder.receive()? {
+///         // do something with output
+///         encoder.recycle(output.encoded_frame);
+///     }
+///
+///     Ok(())
+/// }
+/// ```
+pub trait PipelinedVideoEncoder: VideoEncoder {
+    /// Sends a frame to the encoder. Any output that becomes available is queued until it's
+    /// received.
+    fn submit(&mut self, frame: Self::RawVideoFrame, frame_type: EncodedFrameType) -> Result<(), Self::Error>;
+
+    /// Returns the next encoded frame if one is available. `None` means more input is needed, or
+    /// after [`finish`](Self::finish), that all frames have been received.
+    fn receive(&mut self) -> Result<Option<VideoEncoderOutput<Self::RawVideoFrame>>, Self::Error>;
+
+    /// Indicates to the encoder that no more input will be provided. Delayed frames can then be
+    /// received until `None` is returned.
+    fn finish(&mut self) -> Result<(), Self::Error>;
+
+    /// Gives an encoded frame's buffer back to the encoder for reuse.
+    fn recycle(&mut self, frame: EncodedVideoFrame);
+}
+
 #[cfg(test)]
 mod test {
     use super::*;
@@ -97,4 +190,25 @@ mod test {
     fn test_video_encoder_object_safety() {
         let _e: *const dyn VideoEncoder<Error = (), RawVideoFrame = ()>;
     }
+
+    #[test]
+    fn test_pipelined_video_encoder_object_safety() {
+        let _e: *const dyn PipelinedVideoEncoder<Error = (), RawVideoFrame = ()>;
+    }
+
+    #[test]
+    fn test_encoded_video_frame_pool() {
+        let mut pool = EncodedVideoFramePool::new();
+        let mut buf = pool.take(100);
+        assert!(buf.capacity() >= 100);
+        buf.extend_from_slice(&[1, 2, 3]);
+        let ptr = buf.as_ptr();
+        pool.recycle(EncodedVideoFrame { data: buf, is_keyframe: false });
+        assert_eq!(pool.len(), 1);
+
+        let buf = pool.take(50);
+        assert!(buf.is_empty());
+        assert_eq!(buf.as_ptr(), ptr);
+        assert!(pool.is_empty());
+    }
 }
@@ -0,0 +1,78 @@
+use criterion::{black_box, criterion_group, criterion_main, Criterion};
+use h264::{Bitstream, Decode, NALUnit, RBSPSlice, SequenceParameterSet, RBSP};
+
+/// Generates a pseudo-random, escaped NALU payload of the given length.
+fn nalu_payload(len: usize) -> Vec<u8> {
+    let mut state = 0x2545_f491_4f6c_dd1du64;
+    let mut ret = Vec::with_capacity(len);
+    while ret.len() < len {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        let b = state as u8;
+        // avoid producing start codes
+        if b <= 3 && ret.len() >= 2 && ret[ret.len() - 1] == 0 && ret[ret.len() - 2] == 0 {
+            ret.push(3);
+        }
+        ret.push(b);
+    }
+    ret
+}
+
+const SPS: &[u8] = &[
+    0x67, 0x4d, 0x40, 0x1f, 0xec, 0xa0, 0x28, 0x02, 0xdd, 0x80, 0xb5, 0x01, 0x01, 0x01, 0x40, 0x00, 0x00, 0x03, 0x00, 0x40, 0x00, 0x05, 0xdc, 0x03, 0xc6, 0x0c,
+    0x65, 0x80,
+];
+
+fn criterion_benchmark(c: &mut Criterion) {
+    c.bench_function("iterate_annex_b", |b| {
+        let mut data = Vec::new();
+        for _ in 0..64 {
+            data.extend_from_slice(&[0, 0, 0, 1, 0x65]);
+            data.extend(nalu_payload(64 * 1024));
+        }
+        b.iter(|| h264::iterate_annex_b(black_box(&data)).count())
+    });
+
+    c.bench_function("sps_iterator", |b| {
+        b.iter(|| {
+            let mut nalu = NALUnit::decode(Bitstream::new(black_box(SPS).iter().copied())).unwrap();
+            SequenceParameterSet::decode(&mut Bitstream::new(&mut nalu.rbsp_byte)).unwrap()
+        })
+    });
+
+    c.bench_function("sps_slice", |b| {
+        b.iter(|| {
+            let nalu = NALUnit::decode_slice(black_box(SPS)).unwrap();
+            SequenceParameterSet::decode(&mut nalu.rbsp_byte.bitstream()).unwrap()
+        })
+    });
+
+    let payload = nalu_payload(64 * 1024);
+
+    c.bench_function("rbsp_read_bits_iterator", |b| {
+        b.iter(|| {
+            let mut rbsp = RBSP::new(black_box(&payload).iter().copied());
+            let mut bs = Bitstream::new(&mut rbsp);
+            let mut sum = 0u64;
+            while let Ok(bits) = bs.read_bits(27) {
+                sum = sum.wrapping_add(bits);
+            }
+            sum
+        })
+    });
+
+    c.bench_function("rbsp_read_bits_slice", |b| {
+        b.iter(|| {
+            let mut bs = Bitstream::from_source(RBSPSlice::new(black_box(&payload)));
+            let mut sum = 0u64;
+            while let Ok(bits) = bs.read_bits(27) {
+                sum = sum.wrapping_add(bits);
+            }
+            sum
+        })
+    });
+}
+
+criterion_group!(benches, criterion_benchmark);
+criterion_main!(benches);
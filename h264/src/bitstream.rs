@@ -1,5 +1,36 @@
 use std::io;
 
+/// ByteSource provides the bytes that a Bitstream reads from. It's implemented for all byte
+/// iterators, which hand out one byte at a time, and for RBSPSlice, which reads whole words from a
+/// contiguous buffer.
+pub trait ByteSource {
+    /// If true, Bitstream may read up to 8 bytes before they're needed. This makes reads cheaper,
+    /// but bytes that have been read ahead are not returned by Bitstream::into_inner.
+    const READ_AHEAD: bool = false;
+
+    fn next_byte(&mut self) -> Option<u8>;
+
+    /// Reads up to n bytes, where n is at most 8, returning them as a big-endian integer along with
+    /// the number of bytes actually read. Fewer than n bytes are only returned at the end of the
+    /// source.
+    fn next_bytes(&mut self, n: usize) -> (u64, usize) {
+        let mut ret = 0;
+        for i in 0..n {
+            match self.next_byte() {
+                Some(b) => ret = (ret << 8) | b as u64,
+                None => return (ret, i),
+            }
+        }
+        (ret, n)
+    }
+}
+
+impl<T: Iterator<Item = u8>> ByteSource for T {
+    fn next_byte(&mut self) -> Option<u8> {
+        self.next()
+    }
+}
+
 pub struct Bitstream<T> {
     inner: T,
     next_bits: u128,
@@ -8,8 +39,14 @@ pub struct Bitstream<T> {
 
 impl<T: Iterator<Item = u8>> Bitstream<T> {
     pub fn new<U: IntoIterator<Item = u8, IntoIter = T>>(inner: U) -> Self {
+        Self::from_source(inner.into_iter())
+    }
+}
+
+impl<T: ByteSource> Bitstream<T> {
+    pub fn from_source(inner: T) -> Self {
         Self {
-            inner: inner.into_iter(),
+            inner,
             next_bits: 0,
             next_bits_length: 0,
         }
@@ -23,14 +60,17 @@ impl<T: Iterator<Item = u8>> Bitstream<T> {
         if n > self.next_bits_length {
             n -= self.next_bits_length;
             self.next_bits_length = 0;
-            for _ in 0..(n / 8) {
-                if self.inner.next().is_none() {
+            let mut bytes = n / 8;
+            while bytes > 0 {
+                let (_, read) = self.inner.next_bytes(bytes.min(8));
+                if read == 0 {
                     return false;
                 }
+                bytes -= read;
             }
             n %= 8;
             if n > 0 {
-                self.next_bits = match self.inner.next() {
+                self.next_bits = match self.inner.next_byte() {
                     Some(b) => b as u128,
                     None => return false,
                 };
@@ -47,10 +87,17 @@ impl<T: Iterator<Item = u8>> Bitstream<T> {
     }
 
     pub fn next_bits(&mut self, n: usize) -> Option<u64> {
+        // Unless the source allows reading ahead, only pull as many bytes as are needed so that
+        // into_inner doesn't lose any. Since n is at most 64, the accumulator always has room for
+        // 8 more bytes.
         while self.next_bits_length < n {
-            let b = self.inner.next()? as u128;
-            self.next_bits = (self.next_bits << 8) | b;
-            self.next_bits_length += 8;
+            let wanted = if T::READ_AHEAD { 8 } else { (n - self.next_bits_length + 7) / 8 };
+            let (bytes, read) = self.inner.next_bytes(wanted);
+            if read == 0 {
+                return None;
+            }
+            self.next_bits = (self.next_bits << (8 * read)) | bytes as u128;
+            self.next_bits_length += 8 * read;
         }
         Some(((self.next_bits >> (self.next_bits_length - n)) & (0xffff_ffff_ffff_ffff >> (64 - n))) as u64)
     }
@@ -76,7 +123,14 @@ impl<T: Iterator<Item = u8>> Bitstream<T> {
             ret.push(self.read_bits(8)? as _);
             read += 1;
         }
-        ret.extend((&mut self.inner).take(n - read));
+        while read < n {
+            let (bytes, len) = self.inner.next_bytes((n - read).min(8));
+            ret.extend_from_slice(&bytes.to_be_bytes()[8 - len..]);
+            read += len;
+            if len == 0 {
+                break;
+            }
+        }
         if ret.len() < n {
             return Err(io::Error::new(io::ErrorKind::UnexpectedEof, "unexpected end of bitstream"));
         }
@@ -100,6 +154,8 @@ impl<T: Iterator<Item = u8>> Bitstream<T> {
         }
     }
 
+    /// Returns the underlying byte source. Any bits that have been read from it but not consumed
+    /// are discarded.
     pub fn into_inner(self) -> T {
         self.inner
     }
@@ -114,7 +170,7 @@ pub struct BitstreamBits<'a, T> {
     bs: &'a mut Bitstream<T>,
 }
 
-impl<'a, T: Iterator<Item = u8>> Iterator for BitstreamBits<'a, T> {
+impl<'a, T: ByteSource> Iterator for BitstreamBits<'a, T> {
     type Item = bool;
 
     fn next(&mut self) -> Option<Self::Item> {
@@ -123,7 +179,7 @@ impl<'a, T: Iterator<Item = u8>> Iterator for BitstreamBits<'a, T> {
 }
 
 pub trait Decode: Sized {
-    fn decode<T: Iterator<Item = u8>>(bs: &mut Bitstream<T>) -> io::Result<Self>;
+    fn decode<T: ByteSource>(bs: &mut Bitstream<T>) -> io::Result<Self>;
 }
 
 pub struct BitstreamWriter<T: io::Write> {
@@ -1,5 +1,6 @@
 use std::{
     collections::VecDeque,
+    convert::TryInto,
     io::{self, Read},
     iter::Iterator,
 };
@@ -65,6 +66,32 @@ pub fn iterate_annex_b<T: AsRef<[u8]>>(buf: &'_ T) -> AnnexBIter<'_> {
     AnnexBIter { buf: buf.as_ref() }
 }
 
+/// Returns the offset of the first zero byte followed by another zero byte and then a byte less
+/// than or equal to one, i.e. the first three-byte start code or the first zero_byte of a
+/// four-byte one. The buffer is scanned a word at a time, only inspecting individual bytes in
+/// words that contain a zero.
+fn find_start_code_or_zero_byte(buf: &[u8]) -> Option<usize> {
+    let mut pos = 0;
+    while pos + 8 <= buf.len() {
+        let word = u64::from_le_bytes(buf[pos..pos + 8].try_into().expect("the slice is 8 bytes long"));
+        if nal_unit::has_byte(word, 0, 8) {
+            for i in pos..pos + 8 {
+                if i + 2 < buf.len() && buf[i] == 0 && buf[i + 1] == 0 && buf[i + 2] <= 1 {
+                    return Some(i);
+                }
+            }
+        }
+        pos += 8;
+    }
+    while pos + 2 < buf.len() {
+        if buf[pos] == 0 && buf[pos + 1] == 0 && buf[pos + 2] <= 1 {
+            return Some(pos);
+        }
+        pos += 1;
+    }
+    None
+}
+
 impl<'a> Iterator for AnnexBIter<'a> {
     type Item = &'a [u8];
 
@@ -72,31 +99,20 @@ impl<'a> Iterator for AnnexBIter<'a> {
         let mut pos = 0;
         let mut len = self.buf.len();
         loop {
-            loop {
-                if len == 0 || self.buf[pos] != 0 {
-                    return None;
-                } else if len >= 3 && self.buf[pos] == 0 && self.buf[pos + 1] == 0 && self.buf[pos + 2] == 1 {
-                    break;
-                }
-                pos += 1;
-                len -= 1;
-            }
-
-            pos += 3;
-            len -= 3;
-
-            let nalu = pos;
-
-            loop {
-                if len == 0 || (len >= 3 && self.buf[pos] == 0 && self.buf[pos + 1] == 0 && self.buf[pos + 2] <= 1) {
-                    let ret = &self.buf[nalu..pos];
-                    self.buf = &self.buf[pos..];
-                    return Some(ret);
-                }
-                pos += 1;
-                len -= 1;
+            if len == 0 || self.buf[pos] != 0 {
+                return None;
+            } else if len >= 3 && self.buf[pos] == 0 && self.buf[pos + 1] == 0 && self.buf[pos + 2] == 1 {
+                break;
             }
+            pos += 1;
+            len -= 1;
         }
+
+        let nalu = pos + 3;
+        let end = find_start_code_or_zero_byte(&self.buf[nalu..]).map(|n| nalu + n).unwrap_or(self.buf.len());
+        let ret = &self.buf[nalu..end];
+        self.buf = &self.buf[end..];
+        Some(ret)
     }
 }
 
@@ -181,7 +197,12 @@ pub struct AccessUnitCounter {
     maybe_start_new_access_unit: bool,
     count: u64,
     sps: Option<SequenceParameterSet>,
+    // The raw bytes of the SPS NALU that sps was decoded from. Parameter sets are usually repeated
+    // verbatim, so this lets the repeats be skipped.
+    sps_nalu: Vec<u8>,
     prev_frame_num: u64,
+    // Set when a non-VCL NALU starts an access unit, until a slice tells us its frame_num.
+    frame_num_pending: bool,
 }
 
 impl Default for AccessUnitCounter {
@@ -196,7 +217,9 @@ impl AccessUnitCounter {
             maybe_start_new_access_unit: true,
             count: 0,
             sps: None,
+            sps_nalu: Vec::new(),
             prev_frame_num: 0,
+            frame_num_pending: false,
         }
     }
 
@@ -212,17 +235,18 @@ impl AccessUnitCounter {
         // TODO: implement the rest of 7.4.1.2.4?
         match nalu_type {
             1 | 2 => {
-                if self.maybe_start_new_access_unit {
+                // If a non-VCL NALU already started this access unit, the frame_num still has to
+                // be recorded. Otherwise the next slice of the same picture looks like a new one.
+                if self.maybe_start_new_access_unit || self.frame_num_pending {
                     if let Some(sps) = &self.sps {
-                        let bs = Bitstream::new(nalu.iter().copied());
-                        let mut nalu = NALUnit::decode(bs)?;
-                        let mut rbsp = Bitstream::new(&mut nalu.rbsp_byte);
-                        let slice_header = SliceHeader::decode(&mut rbsp, sps)?;
-                        if slice_header.frame_num != self.prev_frame_num {
-                            self.prev_frame_num = slice_header.frame_num;
+                        let nalu = NALUnit::decode_slice(nalu)?;
+                        let slice_header = SliceHeader::decode(&mut nalu.rbsp_byte.bitstream(), sps)?;
+                        if self.maybe_start_new_access_unit && slice_header.frame_num != self.prev_frame_num {
                             self.count += 1;
                         }
+                        self.prev_frame_num = slice_header.frame_num;
                     }
+                    self.frame_num_pending = false;
                 }
                 self.maybe_start_new_access_unit = true;
             }
@@ -230,18 +254,19 @@ impl AccessUnitCounter {
             6 | 7 | 8 | 9 | 14 | 15 | 16 | 17 | 18 => {
                 if self.maybe_start_new_access_unit {
                     self.maybe_start_new_access_unit = false;
+                    self.frame_num_pending = true;
                     self.count += 1;
                 }
             }
             _ => {}
         }
 
-        if let NAL_UNIT_TYPE_SEQUENCE_PARAMETER_SET = nalu_type {
-            let bs = Bitstream::new(nalu.iter().copied());
-            let mut nalu = NALUnit::decode(bs)?;
-            let mut rbsp = Bitstream::new(&mut nalu.rbsp_byte);
-            let sps = SequenceParameterSet::decode(&mut rbsp)?;
+        if nalu_type == NAL_UNIT_TYPE_SEQUENCE_PARAMETER_SET && self.sps_nalu != nalu {
+            let sps_nalu = NALUnit::decode_slice(nalu)?;
+            let sps = SequenceParameterSet::decode(&mut sps_nalu.rbsp_byte.bitstream())?;
             self.sps = Some(sps);
+            self.sps_nalu.clear();
+            self.sps_nalu.extend_from_slice(nalu);
         }
 
         Ok(())
@@ -259,6 +284,21 @@ mod test {
         assert_eq!(expected, iterate_annex_b(&data).collect::<Vec<&[u8]>>());
     }
 
+    #[test]
+    fn test_iterate_annex_b_long() {
+        // Long enough that the start codes land in the middle of the words scanned at a time.
+        let mut data = vec![0x00, 0x00, 0x01];
+        data.extend((0..37).map(|i| i as u8 | 0x80));
+        data.extend(&[0x00, 0x00, 0x00, 0x01]);
+        data.extend((0..21).map(|i| i as u8 | 0x40));
+        data.extend(&[0x00, 0x00, 0x01, 0x05, 0x00, 0x00]);
+        let nalus = iterate_annex_b(&data).collect::<Vec<&[u8]>>();
+        assert_eq!(nalus.len(), 3);
+        assert_eq!(nalus[0], &data[3..40]);
+        assert_eq!(nalus[1], &data[44..65]);
+        assert_eq!(nalus[2], &[0x05, 0x00, 0x00]);
+    }
+
     #[test]
     fn test_read_annex_b() {
         let data = &[0u8, 0x00, 0x00, 0x01, 0x01, 0x02, 0x03, 0x00, 0x00, 0x00, 0x01, 0x04];
@@ -272,4 +312,32 @@ mod test {
         let expected: Vec<&[u8]> = vec![&[0x01, 0x02, 0x03], &[0x04]];
         assert_eq!(expected, iterate_avcc(&data, 4).collect::<Vec<&[u8]>>());
     }
+
+    #[test]
+    fn test_access_unit_counter_repeated_sps() {
+        // The SPS and the first bytes of the first two slices of two pictures from h264-8k.ts.
+        let sps: &[u8] = &[
+            0x67, 0x42, 0x00, 0x3c, 0x96, 0x35, 0x40, 0x3c, 0x00, 0x10, 0xed, 0x35, 0x01, 0x01, 0x01, 0x40, 0x00, 0x00, 0xfa, 0x40, 0x00, 0x3a, 0x98, 0x21,
+        ];
+        let pictures: &[&[&[u8]]] = &[
+            &[
+                &[0x61, 0xe0, 0x20, 0x00, 0x38, 0xb8, 0x04, 0x1f, 0xb4, 0xbc, 0x9d, 0xf7],
+                &[0x61, 0x00, 0x02, 0xa3, 0x0e, 0x02, 0x00, 0x03, 0x8b, 0xe0, 0xe3, 0x1d],
+            ],
+            &[
+                &[0x61, 0xe0, 0x40, 0x00, 0x58, 0xb8, 0x03, 0xa0, 0xe0, 0x8c, 0x7e, 0xfa],
+                &[0x61, 0x00, 0x02, 0xa3, 0x0e, 0x04, 0x00, 0x05, 0x8b, 0x89, 0xe8, 0x5b],
+            ],
+        ];
+
+        // Some encoders put the SPS in front of every picture instead of once per GOP.
+        let mut counter = AccessUnitCounter::new();
+        for slices in pictures {
+            counter.count_nalu(sps).unwrap();
+            for slice in slices.iter() {
+                counter.count_nalu(slice).unwrap();
+            }
+        }
+        assert_eq!(counter.count(), 2);
+    }
 }
@@ -1,6 +1,6 @@
-use super::{decode, encode, syntax_elements::*, Bitstream, BitstreamWriter};
+use super::{decode, encode, syntax_elements::*, Bitstream, BitstreamWriter, ByteSource};
 
-use std::io;
+use std::{convert::TryInto, io};
 
 /// The first byte of each NALU contains its type. If you just need the type without decoding the
 /// NALU, mask the first byte with this.
@@ -98,6 +98,82 @@ impl<T: Iterator<Item = u8>> Iterator for RBSPIter<T> {
     }
 }
 
+/// RBSPSlice reads RBSP data out of a contiguous NALU buffer, skipping emulation prevention bytes.
+/// Unlike RBSPIter, it can hand a Bitstream up to 8 bytes at a time whenever those bytes can't
+/// contain an emulation prevention byte, and it allows the Bitstream to read ahead.
+#[derive(Clone, Copy, Debug)]
+pub struct RBSPSlice<'a> {
+    buf: &'a [u8],
+    zeros: usize,
+}
+
+impl<'a> RBSPSlice<'a> {
+    pub fn new(buf: &'a [u8]) -> Self {
+        Self { buf, zeros: 0 }
+    }
+}
+
+impl<'a> ByteSource for RBSPSlice<'a> {
+    const READ_AHEAD: bool = true;
+
+    fn next_byte(&mut self) -> Option<u8> {
+        loop {
+            let (&b, rest) = self.buf.split_first()?;
+            self.buf = rest;
+            match b {
+                3 if self.zeros >= 2 => {
+                    self.zeros = 0;
+                    continue;
+                }
+                0 => self.zeros += 1,
+                _ => self.zeros = 0,
+            }
+            return Some(b);
+        }
+    }
+
+    fn next_bytes(&mut self, n: usize) -> (u64, usize) {
+        if n > 0 && self.buf.len() >= 8 {
+            let word = u64::from_be_bytes(self.buf[..8].try_into().expect("the slice is 8 bytes long"));
+            let bytes = word >> (64 - 8 * n);
+            // Emulation prevention bytes are always 0x03, so if there are no 0x03 bytes, the bytes
+            // can be returned as-is.
+            if !has_byte(bytes, 3, n) {
+                self.buf = &self.buf[n..];
+                self.zeros = if bytes == 0 { self.zeros + n } else { bytes.trailing_zeros() as usize / 8 };
+                return (bytes, n);
+            }
+        }
+
+        let mut ret = 0;
+        for i in 0..n {
+            match self.next_byte() {
+                Some(b) => ret = (ret << 8) | b as u64,
+                None => return (ret, i),
+            }
+        }
+        (ret, n)
+    }
+}
+
+/// Returns true if any of the low n bytes of word is equal to b.
+#[inline]
+pub(crate) fn has_byte(word: u64, b: u8, n: usize) -> bool {
+    const LO: u64 = 0x0101_0101_0101_0101;
+    const HI: u64 = 0x8080_8080_8080_8080;
+    let x = word ^ (LO * b as u64);
+    let zero_bytes = x.wrapping_sub(LO) & !x & HI;
+    let mask = if n >= 8 { !0 } else { (1u64 << (8 * n)) - 1 };
+    zero_bytes & mask != 0
+}
+
+impl<'a> RBSP<RBSPSlice<'a>> {
+    /// Returns a bitstream over the RBSP.
+    pub fn bitstream(&self) -> Bitstream<RBSPSlice<'a>> {
+        Bitstream::from_source(self.inner)
+    }
+}
+
 /// Adds emulation prevention to RBSP data.
 pub struct EmulationPrevention<T> {
     inner: T,
@@ -184,6 +260,38 @@ impl<T: Iterator<Item = u8>> NALUnit<T> {
     }
 }
 
+impl<'a> NALUnit<RBSPSlice<'a>> {
+    /// Decodes a NALU from a contiguous buffer. This is equivalent to `decode`, but the RBSP is
+    /// read via RBSPSlice, which is significantly faster than going through a byte iterator.
+    pub fn decode_slice(buf: &'a [u8]) -> io::Result<Self> {
+        let mut bs = Bitstream::from_source(RBSPSlice::new(buf));
+        let mut forbidden_zero_bit = F1::default();
+        let mut nal_ref_idc = U2::default();
+        let mut nal_unit_type = U5::default();
+        decode!(bs, &mut forbidden_zero_bit, &mut nal_ref_idc, &mut nal_unit_type)?;
+
+        if forbidden_zero_bit.0 != 0 {
+            return Err(io::Error::new(io::ErrorKind::Other, "non-zero forbidden_zero_bit"));
+        }
+
+        match nal_unit_type.0 {
+            14 | 20 | 21 => return Err(io::Error::new(io::ErrorKind::Other, "unsupported nal_unit_type")),
+            _ => {}
+        }
+
+        // The bitstream may have read ahead, so the RBSP is sliced off of the buffer directly.
+        Ok(Self {
+            forbidden_zero_bit,
+            nal_ref_idc,
+            nal_unit_type,
+            rbsp_byte: RBSP::new(RBSPSlice {
+                buf: &buf[1..],
+                zeros: if buf[0] == 0 { 1 } else { 0 },
+            }),
+        })
+    }
+}
+
 impl<T: IntoIterator<Item = u8>> NALUnit<T> {
     pub fn encode<W: io::Write>(self, bs: &mut BitstreamWriter<W>) -> io::Result<()> {
         encode!(bs, &self.forbidden_zero_bit, &self.nal_ref_idc, &self.nal_unit_type)?;
@@ -204,4 +312,34 @@ mod test {
         let out = EmulationPrevention::new(vec![0, 0, 0, 0]).collect::<Vec<_>>();
         assert_eq!(out, vec![0, 0, 3, 0, 0, 3]);
     }
+
+    #[test]
+    fn test_rbsp_slice() {
+        let data = vec![
+            0x01, 0x00, 0x00, 0x03, 0x00, 0x00, 0x03, 0x01, 0x02, 0x03, 0x04, 0x00, 0x00, 0x03, 0x03, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x00, 0x00,
+            0x03,
+        ];
+        let expected = RBSP::new(data.iter().copied()).into_iter().collect::<Vec<u8>>();
+
+        for chunk_size in 1..=8 {
+            let mut rbsp = RBSPSlice::new(&data);
+            let mut actual = Vec::new();
+            loop {
+                let (bytes, n) = rbsp.next_bytes(chunk_size);
+                actual.extend_from_slice(&bytes.to_be_bytes()[8 - n..]);
+                if n < chunk_size {
+                    break;
+                }
+            }
+            assert_eq!(actual, expected);
+        }
+    }
+
+    #[test]
+    fn test_has_byte() {
+        assert!(has_byte(0x0102_0304_0506_0708, 3, 8));
+        assert!(!has_byte(0x0102_0304_0506_0708, 3, 5));
+        assert!(has_byte(0x0000_0000_0000_0003, 3, 1));
+        assert!(!has_byte(0x0303_0303_0303_0300, 3, 1));
+    }
 }
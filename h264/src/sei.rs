@@ -1,4 +1,4 @@
-use super::{decode, encode, sequence_parameter_set::VUIParameters, syntax_elements::*, Bitstream, BitstreamWriter, Decode, Encode};
+use super::{decode, encode, sequence_parameter_set::VUIParameters, syntax_elements::*, Bitstream, BitstreamWriter, ByteSource, Decode, Encode};
 
 use std::io;
 
@@ -11,7 +11,7 @@ pub struct SEI {
 }
 
 impl Decode for SEI {
-    fn decode<T: Iterator<Item = u8>>(bs: &mut Bitstream<T>) -> io::Result<Self> {
+    fn decode<T: ByteSource>(bs: &mut Bitstream<T>) -> io::Result<Self> {
         let mut ret = Self::default();
         loop {
             ret.sei_message.push(SEIMessage::decode(bs)?);
@@ -40,7 +40,7 @@ pub struct SEIMessage {
 }
 
 impl Decode for SEIMessage {
-    fn decode<T: Iterator<Item = u8>>(bs: &mut Bitstream<T>) -> io::Result<Self> {
+    fn decode<T: ByteSource>(bs: &mut Bitstream<T>) -> io::Result<Self> {
         let mut ret = Self::default();
 
         let mut payload_type = 0;
@@ -116,7 +116,7 @@ pub struct Timecode {
 }
 
 impl PicTiming {
-    pub fn decode<T: Iterator<Item = u8>>(bs: &mut Bitstream<T>, vui_params: &VUIParameters) -> io::Result<Self> {
+    pub fn decode<T: ByteSource>(bs: &mut Bitstream<T>, vui_params: &VUIParameters) -> io::Result<Self> {
         let mut ret = Self::default();
 
         let hrd_params = vui_params.nal_hrd_parameters.as_ref().or(vui_params.vcl_hrd_parameters.as_ref());
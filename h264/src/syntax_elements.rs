@@ -1,4 +1,4 @@
-use super::{Bitstream, BitstreamWriter, Decode, Encode};
+use super::{Bitstream, BitstreamWriter, ByteSource, Decode, Encode};
 
 use std::io;
 
@@ -9,7 +9,7 @@ macro_rules! define_syntax_element_u {
         pub struct $e(pub $t);
 
         impl Decode for $e {
-            fn decode<T: Iterator<Item = u8>>(bs: &mut Bitstream<T>) -> io::Result<Self> {
+            fn decode<T: ByteSource>(bs: &mut Bitstream<T>) -> io::Result<Self> {
                 Ok(Self(bs.read_bits($n)? as _))
             }
         }
@@ -42,7 +42,7 @@ define_syntax_element_u!(F1, u8, 1);
 pub struct UE(pub u64);
 
 impl Decode for UE {
-    fn decode<T: Iterator<Item = u8>>(bs: &mut Bitstream<T>) -> io::Result<Self> {
+    fn decode<T: ByteSource>(bs: &mut Bitstream<T>) -> io::Result<Self> {
         let mut leading_zero_bits = 0;
         while bs.read_bits(1)? == 0 {
             leading_zero_bits += 1;
@@ -62,7 +62,7 @@ impl Encode for UE {
 pub struct SE(pub i64);
 
 impl Decode for SE {
-    fn decode<T: Iterator<Item = u8>>(bs: &mut Bitstream<T>) -> io::Result<Self> {
+    fn decode<T: ByteSource>(bs: &mut Bitstream<T>) -> io::Result<Self> {
         let ue = UE::decode(bs)?;
         let mut value = ((ue.0 + 1) >> 1) as i64;
         if (ue.0 & 1) == 0 {
@@ -82,7 +82,7 @@ impl Encode for SE {
 pub struct ByteAlignment;
 
 impl Decode for ByteAlignment {
-    fn decode<T: Iterator<Item = u8>>(bs: &mut Bitstream<T>) -> io::Result<Self> {
+    fn decode<T: ByteSource>(bs: &mut Bitstream<T>) -> io::Result<Self> {
         if bs.read_bits(1)? != 1 {
             return Err(io::Error::new(io::ErrorKind::Other, "expected byte alignment bit equal to 1"));
         }
@@ -4,8 +4,13 @@ use h265::{
 use std::{
     collections::VecDeque,
     io::{self, Write},
+    sync::{mpsc, Arc},
+    thread,
 };
 
+/// The number of NALUs each stage of `join_pipelined` may get ahead of the next one.
+const QUEUE_DEPTH: usize = 16;
+
 pub fn join<I, II, T, E, Iter, O>(inputs: II, mut output: O) -> Result<(), E>
 where
     E: From<io::Error>,
@@ -16,110 +21,248 @@ where
     O: Write,
 {
     let mut inputs = inputs.into_iter().map(|input| Input::new(input.into_iter())).collect::<Result<Vec<_>, E>>()?;
+    let rewriter = Rewriter::new(&inputs);
+
+    while let Some(nalu) = inputs[0].next_nalu() {
+        let (splice, slice_segment) = rewriter.rewrite_primary(nalu?)?;
+        splice.write_to(&mut output)?;
 
-    let input_0_sps = inputs[0].sps.clone();
-    let mut sps = input_0_sps.clone();
-    sps.pic_width_in_luma_samples.0 = 0;
-    for input in &inputs {
-        sps.pic_width_in_luma_samples.0 += input.sps.pic_width_in_luma_samples.0;
+        if let Some(slice_segment) = slice_segment {
+            for (input, address) in inputs[1..].iter_mut().zip(&rewriter.addresses[1..]) {
+                rewriter.next_secondary(input, &slice_segment, *address)?.write_to(&mut output)?;
+            }
+        }
     }
 
-    let input_0_pps = inputs[0].pps.clone();
-    let mut pps = input_0_pps.clone();
-    pps.tiles_enabled_flag.0 = 1;
-    pps.num_tile_columns_minus1.0 = inputs.len() as u64 - 1;
-    pps.uniform_spacing_flag.0 = 1;
+    Ok(())
+}
 
-    while let Some(nalu) = inputs[0].next_nalu() {
-        let nalu = nalu?;
+/// Performs the same join as `join`, but spread across threads. Each input is read and parsed by
+/// its own worker, which is also where the slice segment headers for that input's tile get
+/// rewritten, so the per-tile work happens in parallel. The calling thread only writes the
+/// results out in order. The stages are connected by bounded queues, so memory use stays flat
+/// regardless of how far ahead the readers could get.
+pub fn join_pipelined<I, II, T, E, Iter, O>(inputs: II, mut output: O) -> Result<(), E>
+where
+    E: From<io::Error> + Send,
+    T: AsRef<[u8]> + Send,
+    I: IntoIterator<Item = Result<T, E>, IntoIter = Iter>,
+    II: IntoIterator<Item = I>,
+    Iter: Iterator<Item = Result<T, E>> + Send,
+    O: Write,
+{
+    let inputs = inputs.into_iter().map(|input| Input::new(input.into_iter())).collect::<Result<Vec<_>, E>>()?;
+    let rewriter = Rewriter::new(&inputs);
+    let rewriter = &rewriter;
+
+    thread::scope(|scope| {
+        let mut inputs = inputs.into_iter();
+        let mut primary = inputs.next().expect("at least one input is required");
 
-        let mut bs = Bitstream::new(nalu.iter().copied());
-        let nalu_header = NALUnitHeader::decode(&mut bs)?;
+        let mut slice_segment_txs = Vec::new();
+        let mut secondary_rxs = Vec::new();
+        for (mut input, address) in inputs.zip(rewriter.addresses[1..].iter().copied()) {
+            let (slice_segment_tx, slice_segment_rx) = mpsc::sync_channel::<Arc<PrimarySliceSegment>>(QUEUE_DEPTH);
+            let (tx, rx) = mpsc::sync_channel(QUEUE_DEPTH);
+            scope.spawn(move || {
+                for slice_segment in slice_segment_rx {
+                    let result = rewriter.next_secondary(&mut input, &slice_segment, address);
+                    let is_err = result.is_err();
+                    if tx.send(result).is_err() || is_err {
+                        break;
+                    }
+                }
+            });
+            slice_segment_txs.push(slice_segment_tx);
+            secondary_rxs.push(rx);
+        }
+
+        let (primary_tx, primary_rx) = mpsc::sync_channel(QUEUE_DEPTH);
+        scope.spawn(move || {
+            while let Some(nalu) = primary.next_nalu() {
+                let result = nalu.and_then(|nalu| Ok(rewriter.rewrite_primary(nalu)?));
+                let is_err = result.is_err();
+                let result = result.map(|(splice, slice_segment)| {
+                    // Hand the header off to the other inputs' workers before the writer needs
+                    // their tiles. If a worker has already quit, the writer will find out about it.
+                    if let Some(slice_segment) = slice_segment {
+                        let slice_segment = Arc::new(slice_segment);
+                        for tx in &slice_segment_txs {
+                            let _ = tx.send(slice_segment.clone());
+                        }
+                        (splice, true)
+                    } else {
+                        (splice, false)
+                    }
+                });
+                if primary_tx.send(result).is_err() || is_err {
+                    break;
+                }
+            }
+        });
+
+        for result in primary_rx {
+            let (splice, is_slice_segment) = result?;
+            splice.write_to(&mut output)?;
+
+            if is_slice_segment {
+                for rx in &secondary_rxs {
+                    let splice = rx
+                        .recv()
+                        .map_err(|_| io::Error::new(io::ErrorKind::UnexpectedEof, "matching slice segment not found"))??;
+                    splice.write_to(&mut output)?;
+                }
+            }
+        }
+
+        Ok(())
+    })
+}
+
+/// A NALU whose leading bytes have been replaced. When written, `prefix` is followed by the bytes
+/// of `nalu` starting at `offset`, so the remainder of the NALU never needs to be copied.
+struct Splice<T> {
+    prefix: Vec<u8>,
+    nalu: T,
+    offset: usize,
+}
+
+impl<T: AsRef<[u8]>> Splice<T> {
+    fn write_to<O: Write>(&self, output: &mut O) -> io::Result<()> {
+        output.write_all(&[0, 0, 0, 1])?;
+        output.write_all(&self.prefix)?;
+        output.write_all(&self.nalu.as_ref()[self.offset..])
+    }
+}
+
+/// The header of one of the first input's slice segments, which the other inputs' slice segments
+/// for the same picture are based on.
+struct PrimarySliceSegment {
+    nalu_header: NALUnitHeader,
+    header: SliceSegmentHeader,
+}
+
+/// Holds the parameter sets needed to turn NALUs from the inputs into NALUs for the joined stream.
+struct Rewriter {
+    input_sps: SequenceParameterSet,
+    input_pps: PictureParameterSet,
+    sps: SequenceParameterSet,
+    pps: PictureParameterSet,
+    /// The slice segment address of each input's tile within the joined picture.
+    addresses: Vec<u64>,
+}
+
+impl Rewriter {
+    fn new<Iter, T>(inputs: &[Input<Iter, T>]) -> Self {
+        let input_sps = inputs[0].sps.clone();
+        let mut sps = input_sps.clone();
+        sps.pic_width_in_luma_samples.0 = 0;
+        for input in inputs {
+            sps.pic_width_in_luma_samples.0 += input.sps.pic_width_in_luma_samples.0;
+        }
+
+        let input_pps = inputs[0].pps.clone();
+        let mut pps = input_pps.clone();
+        pps.tiles_enabled_flag.0 = 1;
+        pps.num_tile_columns_minus1.0 = inputs.len() as u64 - 1;
+        pps.uniform_spacing_flag.0 = 1;
+
+        let mut addresses = Vec::with_capacity(inputs.len());
+        let mut ctb_x = 0;
+        for input in inputs {
+            addresses.push(ctb_x);
+            ctb_x += input.sps.PicWidthInCtbsY();
+        }
+
+        Self {
+            input_sps,
+            input_pps,
+            sps,
+            pps,
+            addresses,
+        }
+    }
+
+    /// Rewrites a NALU from the first input. If it's a slice segment, its header is returned as well.
+    fn rewrite_primary<T: AsRef<[u8]>>(&self, nalu: T) -> io::Result<(Splice<T>, Option<PrimarySliceSegment>)> {
+        let len = nalu.as_ref().len();
+        let nalu_header = NALUnitHeader::decode(&mut Bitstream::new(nalu.as_ref().iter().copied()))?;
 
         match nalu_header.nal_unit_type.0 {
             h265::NAL_UNIT_TYPE_SPS_NUT => {
-                output.write_all(&[0, 0, 0, 1])?;
-                nalu_header.encode(&mut BitstreamWriter::new(&mut output))?;
-                let mut buf = Vec::new();
-                sps.encode(&mut BitstreamWriter::new(&mut buf))?;
-                let buf = EmulationPrevention::new(buf).collect::<Vec<u8>>();
-                output.write_all(&buf)?;
+                let mut rbsp = Vec::new();
+                self.sps.encode(&mut BitstreamWriter::new(&mut rbsp))?;
+                let splice = self.splice_nalu(nalu, &nalu_header, rbsp, len)?;
+                Ok((splice, None))
             }
             h265::NAL_UNIT_TYPE_PPS_NUT => {
-                output.write_all(&[0, 0, 0, 1])?;
-                nalu_header.encode(&mut BitstreamWriter::new(&mut output))?;
-                let mut buf = Vec::new();
-                pps.encode(&mut BitstreamWriter::new(&mut buf))?;
-                let buf = EmulationPrevention::new(buf).collect::<Vec<u8>>();
-                output.write_all(&buf)?;
+                let mut rbsp = Vec::new();
+                self.pps.encode(&mut BitstreamWriter::new(&mut rbsp))?;
+                let splice = self.splice_nalu(nalu, &nalu_header, rbsp, len)?;
+                Ok((splice, None))
             }
             1..=9 | 16..=21 => {
-                // parse the header
-                let bs = Bitstream::new(nalu.iter().copied());
-                let mut nalu = NALUnit::decode(bs)?;
-                let mut header = SliceSegmentHeader::decode(
-                    &mut Bitstream::new(&mut nalu.rbsp_byte),
-                    nalu.nal_unit_header.nal_unit_type.0,
-                    &input_0_sps,
-                    &input_0_pps,
-                )?;
-
-                // write out the new nalus
-
-                let slice_data = nalu.rbsp_byte.into_inner().collect::<Vec<u8>>();
-                output.write_all(&[0, 0, 0, 1])?;
-                nalu_header.encode(&mut BitstreamWriter::new(&mut output))?;
-                let mut buf = Vec::new();
-                header.encode(&mut BitstreamWriter::new(&mut buf), nalu_header.nal_unit_type.0, &sps, &pps)?;
-                let buf = EmulationPrevention::new(buf).collect::<Vec<u8>>();
-                output.write_all(&buf)?;
-                output.write_all(&slice_data)?;
-
-                let mut ctb_x = input_0_sps.PicWidthInCtbsY();
-                for input in &mut inputs[1..] {
-                    header.first_slice_segment_in_pic_flag.0 = 0;
-                    header.slice_segment_address = ctb_x;
-                    ctb_x += input.sps.PicWidthInCtbsY();
-
-                    loop {
-                        let nalu = match input.next_nalu() {
-                            Some(nalu) => nalu?,
-                            None => return Err(io::Error::new(io::ErrorKind::UnexpectedEof, "matching slice segment not found").into()),
-                        };
-                        let bs = Bitstream::new(nalu.iter().copied());
-                        let mut nalu = NALUnit::decode(bs)?;
-
-                        match nalu.nal_unit_header.nal_unit_type.0 {
-                            1..=9 | 16..=21 => {
-                                SliceSegmentHeader::decode(
-                                    &mut Bitstream::new(&mut nalu.rbsp_byte),
-                                    nalu.nal_unit_header.nal_unit_type.0,
-                                    &input_0_sps,
-                                    &input_0_pps,
-                                )?;
-                                output.write_all(&[0, 0, 0, 1])?;
-                                nalu_header.encode(&mut BitstreamWriter::new(&mut output))?;
-                                let mut buf = Vec::new();
-                                header.encode(&mut BitstreamWriter::new(&mut buf), nalu_header.nal_unit_type.0, &sps, &pps)?;
-                                let buf = EmulationPrevention::new(buf).collect::<Vec<u8>>();
-                                output.write_all(&buf)?;
-                                let slice_data = nalu.rbsp_byte.into_inner().collect::<Vec<u8>>();
-                                output.write_all(&slice_data)?;
-                                break;
-                            }
-                            _ => {}
-                        }
-                    }
-                }
+                let (header, offset) = decode_slice_segment_header(nalu.as_ref(), &self.input_sps, &self.input_pps)?;
+                let mut rbsp = Vec::new();
+                header.encode(&mut BitstreamWriter::new(&mut rbsp), nalu_header.nal_unit_type.0, &self.sps, &self.pps)?;
+                let splice = self.splice_nalu(nalu, &nalu_header, rbsp, offset)?;
+                Ok((splice, Some(PrimarySliceSegment { nalu_header, header })))
             }
-            _ => {
-                output.write_all(&[0, 0, 0, 1])?;
-                output.write_all(nalu)?
+            _ => Ok((
+                Splice {
+                    prefix: Vec::new(),
+                    nalu,
+                    offset: 0,
+                },
+                None,
+            )),
+        }
+    }
+
+    /// Reads up to the next slice segment of one of the other inputs and rewrites it to go at the
+    /// given address of the primary input's picture. Everything else from the input is dropped.
+    fn next_secondary<Iter, T, E>(&self, input: &mut Input<Iter, T>, primary: &PrimarySliceSegment, address: u64) -> Result<Splice<T>, E>
+    where
+        T: AsRef<[u8]>,
+        Iter: Iterator<Item = Result<T, E>>,
+        E: From<io::Error>,
+    {
+        loop {
+            let nalu = match input.next_nalu() {
+                Some(nalu) => nalu?,
+                None => return Err(io::Error::new(io::ErrorKind::UnexpectedEof, "matching slice segment not found").into()),
+            };
+            let nalu_header = NALUnitHeader::decode(&mut Bitstream::new(nalu.as_ref().iter().copied()))?;
+
+            if let 1..=9 | 16..=21 = nalu_header.nal_unit_type.0 {
+                let (_, offset) = decode_slice_segment_header(nalu.as_ref(), &self.input_sps, &self.input_pps)?;
+                let mut header = primary.header.clone();
+                header.first_slice_segment_in_pic_flag.0 = 0;
+                header.slice_segment_address = address;
+                let mut rbsp = Vec::new();
+                header.encode(&mut BitstreamWriter::new(&mut rbsp), primary.nalu_header.nal_unit_type.0, &self.sps, &self.pps)?;
+                return Ok(self.splice_nalu(nalu, &primary.nalu_header, rbsp, offset)?);
             }
         }
     }
 
-    Ok(())
+    /// Replaces everything in the NALU before `offset` with the given header and RBSP bytes.
+    fn splice_nalu<T>(&self, nalu: T, nalu_header: &NALUnitHeader, rbsp: Vec<u8>, offset: usize) -> io::Result<Splice<T>> {
+        let mut prefix = Vec::with_capacity(rbsp.len() + 8);
+        nalu_header.encode(&mut BitstreamWriter::new(&mut prefix))?;
+        prefix.extend(&mut EmulationPrevention::new(rbsp));
+        Ok(Splice { prefix, nalu, offset })
+    }
+}
+
+/// Decodes the header of a slice segment NALU, returning it along with the offset of the slice
+/// data within the NALU. Slice segment headers always end byte aligned, so the slice data can be
+/// used as-is after a rewritten header.
+fn decode_slice_segment_header(nalu: &[u8], sps: &SequenceParameterSet, pps: &PictureParameterSet) -> io::Result<(SliceSegmentHeader, usize)> {
+    let mut remaining = nalu.iter().copied();
+    let mut decoded = NALUnit::decode(Bitstream::new(&mut remaining))?;
+    let header = SliceSegmentHeader::decode(&mut Bitstream::new(&mut decoded.rbsp_byte), decoded.nal_unit_header.nal_unit_type.0, sps, pps)?;
+    Ok((header, nalu.len() - remaining.len()))
 }
 
 struct Input<Iter, T> {
@@ -127,7 +270,6 @@ struct Input<Iter, T> {
     nalus: Iter,
     pps: PictureParameterSet,
     sps: SequenceParameterSet,
-    current_nalu: Option<T>,
 }
 
 impl<T: AsRef<[u8]>, Iter: Iterator<Item = Result<T, E>>, E: From<io::Error>> Input<Iter, T> {
@@ -163,21 +305,112 @@ impl<T: AsRef<[u8]>, Iter: Iterator<Item = Result<T, E>>, E: From<io::Error>> In
                 nalus,
                 sps,
                 pps,
-                current_nalu: None,
             }),
             _ => Err(io::Error::new(io::ErrorKind::UnexpectedEof, "parameter sets not found").into()),
         }
     }
 
-    fn next_nalu(&mut self) -> Option<Result<&[u8], E>> {
-        self.current_nalu = Some(if let Some(next) = self.skipped_nalus.pop_front() {
-            next
-        } else {
-            match self.nalus.next()? {
-                Ok(nalu) => nalu,
-                Err(e) => return Some(Err(e)),
+    fn next_nalu(&mut self) -> Option<Result<T, E>> {
+        if let Some(next) = self.skipped_nalus.pop_front() {
+            return Some(Ok(next));
+        }
+        self.nalus.next()
+    }
+}
+
+#[cfg(test)]
+mod test {
+    use super::*;
+    use h265::test_util::{nalu, nalu_results, parameter_set_nalu};
+
+    fn sps() -> SequenceParameterSet {
+        let mut sps = SequenceParameterSet::default();
+        sps.chroma_format_idc.0 = 1;
+        sps.pic_width_in_luma_samples.0 = 32;
+        sps.pic_height_in_luma_samples.0 = 16;
+        sps.sub_layer_ordering_info = vec![Default::default()];
+        sps.log2_diff_max_min_luma_coding_block_size.0 = 1;
+        sps
+    }
+
+    /// The slice data of a picture, which identifies where it came from.
+    fn slice_data(input: u8, picture: u8) -> Vec<u8> {
+        let mut data = vec![0x80 | input, picture + 1];
+        data.resize(2 + input as usize, 0xff);
+        data
+    }
+
+    /// Builds the NALUs of an untiled input with an access unit delimiter and one slice segment
+    /// per picture.
+    fn input(input: u8, pictures: u8) -> Vec<Vec<u8>> {
+        let (sps, pps) = (sps(), PictureParameterSet::default());
+        let mut nalus = vec![
+            parameter_set_nalu(h265::NAL_UNIT_TYPE_SPS_NUT, &sps),
+            parameter_set_nalu(h265::NAL_UNIT_TYPE_PPS_NUT, &pps),
+        ];
+        for picture in 0..pictures {
+            nalus.push(nalu(h265::NAL_UNIT_TYPE_AUD_NUT, vec![0x50]));
+            let mut header = SliceSegmentHeader::default();
+            header.first_slice_segment_in_pic_flag.0 = 1;
+            header.slice_type.0 = 2;
+            let mut rbsp = Vec::new();
+            header
+                .encode(&mut BitstreamWriter::new(&mut rbsp), h265::NAL_UNIT_TYPE_IDR_W_RADL, &sps, &pps)
+                .unwrap();
+            let mut slice_segment = nalu(h265::NAL_UNIT_TYPE_IDR_W_RADL, rbsp);
+            slice_segment.extend(slice_data(input, picture));
+            nalus.push(slice_segment);
+        }
+        nalus
+    }
+
+    #[test]
+    fn test_join() {
+        let inputs: Vec<_> = (0..3).map(|i| input(i, 5)).collect();
+        let mut output = Vec::new();
+        join(nalu_results(&inputs), &mut output).unwrap();
+
+        let mut sps = None;
+        let mut pps = None;
+        let mut slice_segments = 0;
+        for nalu in h265::iterate_annex_b(&output) {
+            let mut decoded = NALUnit::decode(Bitstream::new(nalu.iter().copied())).unwrap();
+            match decoded.nal_unit_header.nal_unit_type.0 {
+                h265::NAL_UNIT_TYPE_SPS_NUT => sps = Some(SequenceParameterSet::decode(&mut Bitstream::new(&mut decoded.rbsp_byte)).unwrap()),
+                h265::NAL_UNIT_TYPE_PPS_NUT => pps = Some(PictureParameterSet::decode(&mut Bitstream::new(&mut decoded.rbsp_byte)).unwrap()),
+                h265::NAL_UNIT_TYPE_IDR_W_RADL => {
+                    let (sps, pps) = (sps.as_ref().unwrap(), pps.as_ref().unwrap());
+                    assert_eq!(sps.pic_width_in_luma_samples.0, 96);
+                    assert_eq!(pps.num_tile_columns_minus1.0, 2);
+
+                    // each picture's slice segments should be the inputs' slice segments in order
+                    let (header, offset) = decode_slice_segment_header(nalu, sps, pps).unwrap();
+                    let (input, picture) = (slice_segments % 3, slice_segments / 3);
+                    assert_eq!(header.first_slice_segment_in_pic_flag.0, (input == 0) as u8);
+                    assert_eq!(header.slice_segment_address, 2 * input as u64);
+                    assert_eq!(&nalu[offset..], slice_data(input, picture));
+                    slice_segments += 1;
+                }
+                _ => {}
             }
-        });
-        Some(Ok(self.current_nalu.as_ref().expect("we just set this").as_ref()))
+        }
+        assert_eq!(slice_segments, 15);
+    }
+
+    #[test]
+    fn test_join_pipelined() {
+        let inputs: Vec<_> = (0..3).map(|i| input(i, 5)).collect();
+
+        let mut expected = Vec::new();
+        join(nalu_results(&inputs), &mut expected).unwrap();
+        let mut actual = Vec::new();
+        join_pipelined(nalu_results(&inputs), &mut actual).unwrap();
+        assert_eq!(expected, actual);
+
+        // a missing slice segment should be an error rather than a hang
+        let mut inputs = inputs;
+        inputs[2].pop();
+        let mut output = Vec::new();
+        assert!(join_pipelined(nalu_results(&inputs), &mut output).is_err());
     }
 }
@@ -1,84 +1,35 @@
 use h265::{
     Bitstream, BitstreamWriter, Decode, EmulationPrevention, Encode, NALUnit, NALUnitHeader, PictureParameterSet, SequenceParameterSet, SliceSegmentHeader,
 };
-use std::io::{self, Write};
+use std::{
+    io::{self, Write},
+    sync::{mpsc, Arc},
+    thread,
+};
+
+/// The number of NALUs each input's worker in `mux_pipelined` may get ahead of the writer.
+const QUEUE_DEPTH: usize = 16;
 
 /// Given an iterator for slice NALUs that are known to correspond to the same frame, writes out
 /// the muxed slice NALU. The output will not contain a length prefix or start code.
-pub fn mux_slices<I, T, O>(nalus: I, selection: &[usize], mut output: O, sps: &SequenceParameterSet, pps: &PictureParameterSet) -> io::Result<()>
+pub fn mux_slices<I, T, O>(nalus: I, selection: &[usize], output: O, sps: &SequenceParameterSet, pps: &PictureParameterSet) -> io::Result<()>
 where
     I: IntoIterator<Item = T>,
     T: AsRef<[u8]>,
     O: Write,
 {
-    struct SliceSegment {
-        nalu_header: NALUnitHeader,
-        header: SliceSegmentHeader,
-        tile_data: Vec<u8>,
-        tiles: Vec<(usize, usize)>,
-    }
-
     // gather all the slice segments
     let mut segments = nalus
         .into_iter()
-        .map(|nalu| -> io::Result<_> {
-            // parse the header
-            let bs = Bitstream::new(nalu.as_ref().iter().copied());
-            let mut nalu = NALUnit::decode(bs)?;
-            let header = SliceSegmentHeader::decode(&mut Bitstream::new(&mut nalu.rbsp_byte), nalu.nal_unit_header.nal_unit_type.0, sps, pps)?;
-            let mut tile_data = nalu.rbsp_byte.into_inner().collect::<Vec<u8>>();
-
-            // drop any cabac_zero_words
-            while tile_data.ends_with(&[0, 0, 3]) {
-                tile_data.truncate(tile_data.len() - 3);
-            }
-
-            // collect the tile offsets
-            let mut tiles: Vec<(usize, usize)> = Vec::new();
-            let mut offset: usize = 0;
-            for entry_offset in &header.entry_point_offset_minus1 {
-                let end = offset + *entry_offset as usize + 1;
-                tiles.push((offset, end - offset));
-                offset = end;
-            }
-            tiles.push((offset, tile_data.len() - offset));
-
-            Ok(SliceSegment {
-                header,
-                nalu_header: nalu.nal_unit_header,
-                tiles,
-                tile_data,
-            })
-        })
-        .collect::<Result<Vec<SliceSegment>, _>>()?;
-
-    // update the entry points in the header
-    for tile in 0..segments[0].header.num_entry_point_offsets.0 as usize {
-        segments[0].header.offset_len_minus1.0 = segments[0].header.offset_len_minus1.0.max(segments[selection[tile]].header.offset_len_minus1.0);
-        segments[0].header.entry_point_offset_minus1[tile] = segments[selection[tile]].header.entry_point_offset_minus1[tile];
-    }
-
-    // write out the new nalu
-    let nalu_header = &segments[0].nalu_header;
-    nalu_header.encode(&mut BitstreamWriter::new(&mut output))?;
-    let mut buf = Vec::new();
-    segments[0]
-        .header
-        .encode(&mut BitstreamWriter::new(&mut buf), nalu_header.nal_unit_type.0, sps, pps)?;
-    let buf = EmulationPrevention::new(buf).collect::<Vec<u8>>();
-    output.write_all(&buf)?;
-    for tile in 0..segments[0].header.num_entry_point_offsets.0 as usize + 1 {
-        let selection = &segments[selection[tile]];
-        let (offset, len) = selection.tiles[tile];
-        output.write_all(&selection.tile_data[offset..offset + len])?;
-    }
+        .map(|nalu| SliceSegment::decode(nalu, sps, pps))
+        .collect::<Result<Vec<_>, _>>()?;
 
-    Ok(())
+    write_muxed_slice_segment(&mut segments, selection, output, sps, pps)
 }
 
 /// Given iterators over results of AsRef<[u8]>, this function writes muxed tiles with start code
 /// prefixes to the given output.
-pub fn mux<I, II, T, E, Iter, O>(inputs: II, selection: &[usize], mut output: O) -> Result<(), E>
+pub fn mux<I, II, T, E, Iter, O>(inputs: II, selection: &[usize], output: O) -> Result<(), E>
 where
     E: From<io::Error>,
     T: AsRef<[u8]>,
@@ -87,40 +38,43 @@ where
     Iter: Iterator<Item = Result<T, E>>,
     O: Write,
 {
-    let mut inputs: Vec<_> = inputs
-        .into_iter()
-        .map(|input| Input {
-            nalus: input.into_iter(),
-            pps: None,
-            sps: None,
-        })
-        .collect();
+    mux_with_selector(inputs, |_| selection, output)
+}
+
+/// Like `mux`, but the selection can change from picture to picture. `selector` is invoked with
+/// the index of each picture before its first slice segment is written, and returns the input
+/// index to use for each tile of that picture. This allows the tiles to follow a moving viewport,
+/// for example.
+pub fn mux_with_selector<I, II, T, E, Iter, O, F, S>(inputs: II, selector: F, mut output: O) -> Result<(), E>
+where
+    E: From<io::Error>,
+    T: AsRef<[u8]>,
+    I: IntoIterator<Item = Result<T, E>, IntoIter = Iter>,
+    II: IntoIterator<Item = I>,
+    Iter: Iterator<Item = Result<T, E>>,
+    O: Write,
+    F: FnMut(u64) -> S,
+    S: AsRef<[usize]>,
+{
+    let mut inputs: Vec<_> = inputs.into_iter().map(|input| Input::new(input.into_iter())).collect();
+    let mut selector = Selector::new(selector);
 
     while let Some(nalu) = inputs[0].next_nalu().transpose()? {
-        let mut bs = Bitstream::new(nalu.as_ref().iter().copied());
-        let nalu_header = NALUnitHeader::decode(&mut bs)?;
-        match nalu_header.nal_unit_type.0 {
-            1..=9 | 16..=21 => {
-                // we can't do anything until we get the pps and sps
-                if inputs[0].pps.is_none() || inputs[0].sps.is_none() {
-                    continue;
+        match nalu {
+            Parsed::SliceSegment { segment, sps, pps } => {
+                let mut segments = vec![segment];
+                for input in &mut inputs[1..] {
+                    match input.next_slice_segment(&sps, &pps) {
+                        Some(segment) => segments.push(segment?),
+                        None => return Err(mismatched_slice_segments().into()),
+                    }
                 }
 
-                let secondary_nalus = inputs[1..]
-                    .iter_mut()
-                    .map(|input| match input.next_slice_segment() {
-                        Some(r) => r,
-                        None => Err(io::Error::new(io::ErrorKind::Other, "input streams do not have the same number of slice segment nalus").into()),
-                    })
-                    .collect::<Result<Vec<_>, _>>()?;
-
-                let mut nalus = vec![nalu.as_ref()];
-                nalus.extend(secondary_nalus.iter().map(|nalu| nalu.as_ref()));
-
                 output.write_all(&[0, 0, 0, 1])?;
-                mux_slices(nalus, selection, &mut output, inputs[0].sps.as_ref().unwrap(), inputs[0].pps.as_ref().unwrap())?;
+                let selection = selector.select(&segments[0].header);
+                write_muxed_slice_segment(&mut segments, selection, &mut output, &sps, &pps)?;
             }
-            _ => {
+            Parsed::Other(nalu) => {
                 output.write_all(&[0, 0, 0, 1])?;
                 output.write_all(nalu.as_ref())?;
             }
@@ -130,53 +84,433 @@ where
     Ok(())
 }
 
+/// Performs the same mux as `mux_with_selector`, but spread across threads. Each input is read
+/// and its slice segments are parsed by its own worker, and the calling thread assembles and
+/// writes out the muxed slice segments in order. The workers are connected to the writer by
+/// bounded queues, so they can only get a few NALUs ahead of it. `selector` is only ever invoked
+/// on the calling thread.
+pub fn mux_pipelined<I, II, T, E, Iter, O, F, S>(inputs: II, selector: F, mut output: O) -> Result<(), E>
+where
+    E: From<io::Error> + Send,
+    T: AsRef<[u8]> + Send,
+    I: IntoIterator<Item = Result<T, E>, IntoIter = Iter>,
+    II: IntoIterator<Item = I>,
+    Iter: Iterator<Item = Result<T, E>> + Send,
+    O: Write,
+    F: FnMut(u64) -> S,
+    S: AsRef<[usize]>,
+{
+    let mut inputs = inputs.into_iter().map(|input| Input::new(input.into_iter()));
+    let mut primary = inputs.next().expect("at least one input is required");
+    let mut selector = Selector::new(selector);
+
+    thread::scope(|scope| {
+        let mut parameter_sets_txs = Vec::new();
+        let mut secondary_rxs = Vec::new();
+        for mut input in inputs {
+            let (parameter_sets_tx, parameter_sets_rx) = mpsc::sync_channel::<(Arc<SequenceParameterSet>, Arc<PictureParameterSet>)>(QUEUE_DEPTH);
+            let (tx, rx) = mpsc::sync_channel(QUEUE_DEPTH);
+            scope.spawn(move || {
+                for (sps, pps) in parameter_sets_rx {
+                    let result = input.next_slice_segment(&sps, &pps).unwrap_or_else(|| Err(mismatched_slice_segments().into()));
+                    let is_err = result.is_err();
+                    if tx.send(result).is_err() || is_err {
+                        break;
+                    }
+                }
+            });
+            parameter_sets_txs.push(parameter_sets_tx);
+            secondary_rxs.push(rx);
+        }
+
+        let (primary_tx, primary_rx) = mpsc::sync_channel(QUEUE_DEPTH);
+        scope.spawn(move || {
+            while let Some(result) = primary.next_nalu() {
+                // The other inputs' slice segments are decoded with this input's parameter sets,
+                // so hand them off before the writer needs them. If a worker has already quit,
+                // the writer will find out about it.
+                if let Ok(Parsed::SliceSegment { sps, pps, .. }) = &result {
+                    for tx in &parameter_sets_txs {
+                        let _ = tx.send((sps.clone(), pps.clone()));
+                    }
+                }
+                let is_err = result.is_err();
+                if primary_tx.send(result).is_err() || is_err {
+                    break;
+                }
+            }
+        });
+
+        for nalu in primary_rx {
+            match nalu? {
+                Parsed::SliceSegment { segment, sps, pps } => {
+                    let mut segments = Vec::with_capacity(secondary_rxs.len() + 1);
+                    segments.push(segment);
+                    for rx in &secondary_rxs {
+                        segments.push(rx.recv().map_err(|_| mismatched_slice_segments())??);
+                    }
+
+                    output.write_all(&[0, 0, 0, 1])?;
+                    let selection = selector.select(&segments[0].header);
+                    write_muxed_slice_segment(&mut segments, selection, &mut output, &sps, &pps)?;
+                }
+                Parsed::Other(nalu) => {
+                    output.write_all(&[0, 0, 0, 1])?;
+                    output.write_all(nalu.as_ref())?;
+                }
+            }
+        }
+
+        Ok(())
+    })
+}
+
+fn mismatched_slice_segments() -> io::Error {
+    io::Error::new(io::ErrorKind::Other, "input streams do not have the same number of slice segment nalus")
+}
+
+/// Tracks the current picture and the selection that goes with it.
+struct Selector<F, S> {
+    selector: F,
+    next_picture: u64,
+    selection: Option<S>,
+}
+
+impl<F: FnMut(u64) -> S, S: AsRef<[usize]>> Selector<F, S> {
+    fn new(selector: F) -> Self {
+        Self {
+            selector,
+            next_picture: 0,
+            selection: None,
+        }
+    }
+
+    /// Returns the selection for the picture that the given slice segment belongs to.
+    fn select(&mut self, header: &SliceSegmentHeader) -> &[usize] {
+        if header.first_slice_segment_in_pic_flag.0 != 0 || self.selection.is_none() {
+            self.selection = Some((self.selector)(self.next_picture));
+            self.next_picture += 1;
+        }
+        self.selection.as_ref().expect("a selection is always made for the first picture").as_ref()
+    }
+}
+
+/// A slice segment NALU along with the location of each of its tiles within the NALU, which
+/// allows the tiles to be written out without being copied anywhere first.
+struct SliceSegment<T> {
+    nalu: T,
+    nalu_header: NALUnitHeader,
+    header: SliceSegmentHeader,
+    tiles: Vec<(usize, usize)>,
+}
+
+impl<T: AsRef<[u8]>> SliceSegment<T> {
+    fn decode(nalu: T, sps: &SequenceParameterSet, pps: &PictureParameterSet) -> io::Result<Self> {
+        // parse the header. it always ends byte aligned, so whatever is left is the tile data
+        let buf = nalu.as_ref();
+        let mut remaining = buf.iter().copied();
+        let mut decoded = NALUnit::decode(Bitstream::new(&mut remaining))?;
+        let header = SliceSegmentHeader::decode(&mut Bitstream::new(&mut decoded.rbsp_byte), decoded.nal_unit_header.nal_unit_type.0, sps, pps)?;
+        let nalu_header = decoded.nal_unit_header;
+        let mut offset = buf.len() - remaining.len();
+
+        // drop any cabac_zero_words
+        let mut end = buf.len();
+        while end >= offset + 3 && buf[..end].ends_with(&[0, 0, 3]) {
+            end -= 3;
+        }
+
+        // collect the tile offsets
+        let mut tiles = Vec::with_capacity(header.entry_point_offset_minus1.len() + 1);
+        for entry_offset in &header.entry_point_offset_minus1 {
+            let tile_end = offset + *entry_offset as usize + 1;
+            tiles.push((offset, tile_end));
+            offset = tile_end;
+        }
+        tiles.push((offset, end));
+
+        Ok(Self {
+            nalu,
+            nalu_header,
+            header,
+            tiles,
+        })
+    }
+
+    fn tile(&self, tile: usize) -> &[u8] {
+        let (start, end) = self.tiles[tile];
+        &self.nalu.as_ref()[start..end]
+    }
+}
+
+/// Writes out the first slice segment with its tiles replaced according to the selection.
+fn write_muxed_slice_segment<T: AsRef<[u8]>, O: Write>(
+    segments: &mut [SliceSegment<T>],
+    selection: &[usize],
+    mut output: O,
+    sps: &SequenceParameterSet,
+    pps: &PictureParameterSet,
+) -> io::Result<()> {
+    let tiles = segments[0].header.num_entry_point_offsets.0 as usize + 1;
+    if selection.len() < tiles {
+        return Err(io::Error::new(io::ErrorKind::InvalidInput, "the selection doesn't cover every tile"));
+    }
+    if selection[..tiles].iter().any(|&input| input >= segments.len()) {
+        return Err(io::Error::new(
+            io::ErrorKind::InvalidInput,
+            "the selection refers to an input that doesn't exist",
+        ));
+    }
+
+    // update the entry points in the header
+    for tile in 0..tiles - 1 {
+        segments[0].header.offset_len_minus1.0 = segments[0].header.offset_len_minus1.0.max(segments[selection[tile]].header.offset_len_minus1.0);
+        segments[0].header.entry_point_offset_minus1[tile] = segments[selection[tile]].header.entry_point_offset_minus1[tile];
+    }
+
+    // write out the new nalu
+    let nalu_header = &segments[0].nalu_header;
+    nalu_header.encode(&mut BitstreamWriter::new(&mut output))?;
+    let mut buf = Vec::new();
+    segments[0]
+        .header
+        .encode(&mut BitstreamWriter::new(&mut buf), nalu_header.nal_unit_type.0, sps, pps)?;
+    let buf = EmulationPrevention::new(buf).collect::<Vec<u8>>();
+    output.write_all(&buf)?;
+    for tile in 0..tiles {
+        output.write_all(segments[selection[tile]].tile(tile))?;
+    }
+
+    Ok(())
+}
+
+/// A NALU read from one of the inputs.
+enum Parsed<T> {
+    SliceSegment {
+        segment: SliceSegment<T>,
+        sps: Arc<SequenceParameterSet>,
+        pps: Arc<PictureParameterSet>,
+    },
+    Other(T),
+}
+
 struct Input<Iter> {
     nalus: Iter,
-    pps: Option<PictureParameterSet>,
-    sps: Option<SequenceParameterSet>,
+    pps: Option<Arc<PictureParameterSet>>,
+    sps: Option<Arc<SequenceParameterSet>>,
 }
 
 impl<T: AsRef<[u8]>, Iter: Iterator<Item = Result<T, E>>, E: From<io::Error>> Input<Iter> {
-    fn next_nalu(&mut self) -> Option<Result<T, E>> {
-        Some(match self.nalus.next()? {
-            Ok(b) => self.inspect_nalu(b.as_ref()).map(|_| b).map_err(|e| e.into()),
-            Err(e) => Err(e),
-        })
+    fn new(nalus: Iter) -> Self {
+        Self { nalus, pps: None, sps: None }
     }
 
-    fn next_slice_segment(&mut self) -> Option<Result<T, E>> {
+    /// Returns the next NALU, parsing it if it's a slice segment. Slice segments that come before
+    /// the parameter sets can't be parsed, so they're skipped.
+    fn next_nalu(&mut self) -> Option<Result<Parsed<T>, E>> {
         loop {
             let nalu = match self.nalus.next()? {
                 Ok(b) => b,
                 Err(e) => return Some(Err(e)),
             };
-            let header = match self.inspect_nalu(nalu.as_ref()) {
-                Ok(h) => h,
+            match self.inspect_nalu(nalu) {
+                Ok(Some(parsed)) => return Some(Ok(parsed)),
+                Ok(None) => {}
                 Err(e) => return Some(Err(e.into())),
+            }
+        }
+    }
+
+    /// Returns the next slice segment, decoded with the given parameter sets. The other inputs'
+    /// slice segments are decoded with the first input's parameter sets, so their own are never
+    /// needed and nothing is skipped if they come late.
+    fn next_slice_segment(&mut self, sps: &SequenceParameterSet, pps: &PictureParameterSet) -> Option<Result<SliceSegment<T>, E>> {
+        loop {
+            let nalu = match self.nalus.next()? {
+                Ok(b) => b,
+                Err(e) => return Some(Err(e)),
             };
-            match header.nal_unit_type.0 {
-                1..=9 | 16..=21 => return Some(Ok(nalu)),
-                _ => {}
+            let nalu_header = match NALUnitHeader::decode(&mut Bitstream::new(nalu.as_ref().iter().copied())) {
+                Ok(nalu_header) => nalu_header,
+                Err(e) => return Some(Err(e.into())),
+            };
+            if let 1..=9 | 16..=21 = nalu_header.nal_unit_type.0 {
+                return Some(SliceSegment::decode(nalu, sps, pps).map_err(Into::into));
             }
         }
     }
 
-    fn inspect_nalu(&mut self, nalu: &[u8]) -> io::Result<NALUnitHeader> {
-        let bs = Bitstream::new(nalu.iter().copied());
-        let mut nalu = NALUnit::decode(bs)?;
-        match nalu.nal_unit_header.nal_unit_type.0 {
+    fn inspect_nalu(&mut self, nalu: T) -> io::Result<Option<Parsed<T>>> {
+        let bs = Bitstream::new(nalu.as_ref().iter().copied());
+        let mut decoded = NALUnit::decode(bs)?;
+        match decoded.nal_unit_header.nal_unit_type.0 {
             h265::NAL_UNIT_TYPE_PPS_NUT => {
-                let mut rbsp = Bitstream::new(&mut nalu.rbsp_byte);
+                let mut rbsp = Bitstream::new(&mut decoded.rbsp_byte);
                 let pps = PictureParameterSet::decode(&mut rbsp)?;
-                self.pps = Some(pps);
+                self.pps = Some(Arc::new(pps));
             }
             h265::NAL_UNIT_TYPE_SPS_NUT => {
-                let mut rbsp = Bitstream::new(&mut nalu.rbsp_byte);
+                let mut rbsp = Bitstream::new(&mut decoded.rbsp_byte);
                 let sps = SequenceParameterSet::decode(&mut rbsp)?;
-                self.sps = Some(sps);
+                self.sps = Some(Arc::new(sps));
+            }
+            1..=9 | 16..=21 => {
+                // we can't do anything until we get the pps and sps
+                return Ok(match (&self.sps, &self.pps) {
+                    (Some(sps), Some(pps)) => Some(Parsed::SliceSegment {
+                        segment: SliceSegment::decode(nalu, sps, pps)?,
+                        sps: sps.clone(),
+                        pps: pps.clone(),
+                    }),
+                    _ => None,
+                });
             }
             _ => {}
         }
-        Ok(nalu.nal_unit_header)
+        Ok(Some(Parsed::Other(nalu)))
+    }
+}
+
+#[cfg(test)]
+mod test {
+    use super::*;
+    use h265::test_util::{nalu, nalu_results, parameter_set_nalu};
+
+    const TILE_COLUMNS: u8 = 4;
+
+    fn sps() -> SequenceParameterSet {
+        let mut sps = SequenceParameterSet::default();
+        sps.chroma_format_idc.0 = 1;
+        sps.pic_width_in_luma_samples.0 = 16 * TILE_COLUMNS as u64;
+        sps.pic_height_in_luma_samples.0 = 16;
+        sps.sub_layer_ordering_info = vec![Default::default()];
+        sps.log2_diff_max_min_luma_coding_block_size.0 = 1;
+        sps
+    }
+
+    fn pps() -> PictureParameterSet {
+        let mut pps = PictureParameterSet::default();
+        pps.tiles_enabled_flag.0 = 1;
+        pps.num_tile_columns_minus1.0 = TILE_COLUMNS as u64 - 1;
+        pps.uniform_spacing_flag.0 = 1;
+        pps
+    }
+
+    /// The contents of a tile, which identify where it came from. The length differs from input to
+    /// input so that the entry points do too.
+    fn tile(input: u8, picture: u8, tile: u8) -> Vec<u8> {
+        let mut data = vec![0x80 | input, picture + 1, tile + 1];
+        data.resize(3 + (input + tile) as usize, 0xff);
+        data
+    }
+
+    fn slice_segment_nalu(input: u8, picture: u8) -> Vec<u8> {
+        let tiles: Vec<_> = (0..TILE_COLUMNS).map(|t| tile(input, picture, t)).collect();
+        let mut header = SliceSegmentHeader::default();
+        header.first_slice_segment_in_pic_flag.0 = 1;
+        header.slice_type.0 = 2;
+        header.num_entry_point_offsets.0 = TILE_COLUMNS as u64 - 1;
+        header.offset_len_minus1.0 = 7;
+        header.entry_point_offset_minus1 = tiles[..tiles.len() - 1].iter().map(|t| t.len() as u64 - 1).collect();
+        let mut rbsp = Vec::new();
+        header
+            .encode(&mut BitstreamWriter::new(&mut rbsp), h265::NAL_UNIT_TYPE_IDR_W_RADL, &sps(), &pps())
+            .unwrap();
+        let mut nalu = nalu(h265::NAL_UNIT_TYPE_IDR_W_RADL, rbsp);
+        nalu.extend(tiles.concat());
+        nalu
+    }
+
+    /// Builds the NALUs of an input with an access unit delimiter and one slice segment per
+    /// picture. The parameter sets are placed before the picture with the given index.
+    fn input(input: u8, pictures: u8, parameter_sets_before: u8) -> Vec<Vec<u8>> {
+        let mut nalus = Vec::new();
+        for picture in 0..pictures {
+            if picture == parameter_sets_before {
+                nalus.push(parameter_set_nalu(h265::NAL_UNIT_TYPE_SPS_NUT, &sps()));
+                nalus.push(parameter_set_nalu(h265::NAL_UNIT_TYPE_PPS_NUT, &pps()));
+            }
+            nalus.push(nalu(h265::NAL_UNIT_TYPE_AUD_NUT, vec![0x50]));
+            nalus.push(slice_segment_nalu(input, picture));
+        }
+        nalus
+    }
+
+    #[test]
+    fn test_mux_pipelined() {
+        let inputs: Vec<_> = (0..3).map(|i| input(i, 5, 0)).collect();
+        let selections = [[0, 1, 2, 0], [2, 2, 1, 1], [1, 0, 0, 2]];
+
+        let mut expected = Vec::new();
+        mux(nalu_results(&inputs), &[0, 2, 1, 0], &mut expected).unwrap();
+        let mut actual = Vec::new();
+        mux_pipelined(nalu_results(&inputs), |_| [0, 2, 1, 0], &mut actual).unwrap();
+        assert_eq!(expected, actual);
+
+        let mut expected = Vec::new();
+        mux_with_selector(nalu_results(&inputs), |picture| selections[picture as usize % 3], &mut expected).unwrap();
+        let mut actual = Vec::new();
+        mux_pipelined(nalu_results(&inputs), |picture| selections[picture as usize % 3], &mut actual).unwrap();
+        assert_eq!(expected, actual);
+
+        // a missing slice segment should be an error rather than a hang
+        let mut inputs = inputs;
+        inputs[2].pop();
+        let mut output = Vec::new();
+        assert!(mux_pipelined(nalu_results(&inputs), |_| [0, 2, 1, 0], &mut output).is_err());
+    }
+
+    #[test]
+    fn test_mux_with_selector() {
+        let inputs: Vec<_> = (0..3).map(|i| input(i, 5, 0)).collect();
+        let selections = [[0, 1, 2, 0], [2, 2, 1, 1], [1, 0, 0, 2]];
+
+        let mut output = Vec::new();
+        mux_with_selector(nalu_results(&inputs), |picture| selections[picture as usize % 3], &mut output).unwrap();
+
+        let (sps, pps) = (sps(), pps());
+        let mut picture = 0;
+        for nalu in h265::iterate_annex_b(&output) {
+            let nalu_header = NALUnitHeader::decode(&mut Bitstream::new(nalu.iter().copied())).unwrap();
+            if nalu_header.nal_unit_type.0 == h265::NAL_UNIT_TYPE_IDR_W_RADL {
+                let segment = SliceSegment::decode(nalu, &sps, &pps).unwrap();
+                for (t, &input) in selections[picture as usize % 3].iter().enumerate() {
+                    assert_eq!(segment.tile(t), tile(input as u8, picture, t as u8));
+                }
+                picture += 1;
+            }
+        }
+        assert_eq!(picture, 5);
+    }
+
+    #[test]
+    fn test_mux_invalid_selection() {
+        let inputs: Vec<_> = (0..3).map(|i| input(i, 5, 0)).collect();
+
+        // too few tiles, or an input that doesn't exist
+        for selection in &[&[0, 1, 2][..], &[0, 1, 3, 0][..]] {
+            let mut output = Vec::new();
+            let err = mux(nalu_results(&inputs), selection, &mut output).unwrap_err();
+            assert_eq!(err.kind(), io::ErrorKind::InvalidInput);
+            let err = mux_pipelined(nalu_results(&inputs), |_| selection, &mut output).unwrap_err();
+            assert_eq!(err.kind(), io::ErrorKind::InvalidInput);
+        }
+    }
+
+    #[test]
+    fn test_mux_late_parameter_sets() {
+        let inputs: Vec<_> = (0..3).map(|i| input(i, 5, 0)).collect();
+        let mut expected = Vec::new();
+        mux(nalu_results(&inputs), &[0, 2, 1, 0], &mut expected).unwrap();
+
+        // the other inputs' slice segments are decoded with the first input's parameter sets, so
+        // when theirs arrive doesn't matter
+        let inputs = vec![input(0, 5, 0), input(1, 5, 2), input(2, 5, 5)];
+        let mut actual = Vec::new();
+        mux(nalu_results(&inputs), &[0, 2, 1, 0], &mut actual).unwrap();
+        assert_eq!(expected, actual);
+        let mut actual = Vec::new();
+        mux_pipelined(nalu_results(&inputs), |_| [0, 2, 1, 0], &mut actual).unwrap();
+        assert_eq!(expected, actual);
     }
 }
@@ -54,7 +54,7 @@ fn main() -> Result<(), BoxError> {
 
     let output = File::create(matches.value_of("output").unwrap())?;
 
-    mux(inputs.into_iter().map(h265::read_annex_b), &selection, output)?;
+    mux_pipelined(inputs.into_iter().map(h265::read_annex_b), |_| &selection, output)?;
 
     Ok(())
 }
@@ -26,6 +26,9 @@ pub use video_parameter_set::*;
 pub mod syntax_elements;
 pub use syntax_elements::*;
 
+#[cfg(feature = "test-util")]
+pub mod test_util;
+
 pub use h264::{iterate_annex_b, iterate_avcc, read_annex_b, ReadAnnexB};
 
 #[derive(Clone)]
@@ -62,10 +65,8 @@ impl AccessUnitCounter {
         match header.nal_unit_type.0 {
             0..=9 | 16..=21 => {
                 if self.maybe_start_new_access_unit {
-                    let bs = Bitstream::new(nalu.iter().copied());
-                    let mut nalu = NALUnit::decode(bs)?;
-                    let mut rbsp = Bitstream::new(&mut nalu.rbsp_byte);
-                    let first_slice_segment_in_pic_flag = U1::decode(&mut rbsp)?;
+                    let nalu = NALUnit::decode_slice(nalu)?;
+                    let first_slice_segment_in_pic_flag = U1::decode(&mut nalu.rbsp_byte.bitstream())?;
                     if first_slice_segment_in_pic_flag.0 != 0 {
                         self.count += 1;
                     }
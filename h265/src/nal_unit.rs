@@ -1,5 +1,5 @@
-use super::{decode, encode, syntax_elements::*, Bitstream, BitstreamWriter, Decode, Encode};
-pub use h264::{EmulationPrevention, RBSP};
+use super::{decode, encode, syntax_elements::*, Bitstream, BitstreamWriter, ByteSource, Decode, Encode};
+pub use h264::{EmulationPrevention, RBSPSlice, RBSP};
 use std::io;
 
 pub const NAL_UNIT_TYPE_TRAIL_N: u8 = 0;
@@ -23,6 +23,7 @@ pub const NAL_UNIT_TYPE_RSV_IRAP_VCL23: u8 = 23;
 pub const NAL_UNIT_TYPE_VPS_NUT: u8 = 32;
 pub const NAL_UNIT_TYPE_SPS_NUT: u8 = 33;
 pub const NAL_UNIT_TYPE_PPS_NUT: u8 = 34;
+pub const NAL_UNIT_TYPE_AUD_NUT: u8 = 35;
 
 // ITU-T H.265, 11/2019, 7.3.1.1
 pub struct NALUnit<RBSP> {
@@ -50,6 +51,20 @@ impl<T: Iterator<Item = u8>> NALUnit<RBSP<T>> {
     }
 }
 
+impl<'a> NALUnit<RBSP<RBSPSlice<'a>>> {
+    /// Decodes a NALU from a contiguous buffer. This is equivalent to `decode`, but the RBSP is
+    /// read via RBSPSlice, which is significantly faster than going through a byte iterator.
+    pub fn decode_slice(buf: &'a [u8]) -> io::Result<Self> {
+        let nal_unit_header = NALUnitHeader::decode(&mut Bitstream::from_source(RBSPSlice::new(buf)))?;
+        // The bitstream may have read ahead, so the RBSP is sliced off of the buffer directly. The
+        // header's second byte is never zero, so emulation prevention can't span the boundary.
+        Ok(Self {
+            nal_unit_header,
+            rbsp_byte: RBSP::new(RBSPSlice::new(&buf[2..])),
+        })
+    }
+}
+
 impl<RBSP: IntoIterator<Item = u8>> NALUnit<RBSP> {
     pub fn encode<T: io::Write>(self, bs: &mut BitstreamWriter<T>) -> io::Result<()> {
         self.nal_unit_header.encode(bs)?;
@@ -69,7 +84,7 @@ pub struct NALUnitHeader {
 }
 
 impl Decode for NALUnitHeader {
-    fn decode<T: Iterator<Item = u8>>(bs: &mut Bitstream<T>) -> io::Result<Self> {
+    fn decode<T: ByteSource>(bs: &mut Bitstream<T>) -> io::Result<Self> {
         let mut ret = Self::default();
 
         decode!(
@@ -1,4 +1,4 @@
-use super::{decode, encode, syntax_elements::*, Bitstream, BitstreamWriter, Decode, Encode};
+use super::{decode, encode, syntax_elements::*, Bitstream, BitstreamWriter, ByteSource, Decode, Encode};
 use std::io;
 
 // ITU-T H.265, 11/2019 7.3.2.3.1
@@ -99,7 +99,7 @@ impl PictureParameterSet {
 }
 
 impl Decode for PictureParameterSet {
-    fn decode<T: Iterator<Item = u8>>(bs: &mut Bitstream<T>) -> io::Result<Self> {
+    fn decode<T: ByteSource>(bs: &mut Bitstream<T>) -> io::Result<Self> {
         let mut ret = Self::default();
 
         decode!(
@@ -1,4 +1,4 @@
-use super::{decode, encode, syntax_elements::*, Bitstream, BitstreamWriter, Decode, Encode, ProfileTierLevel};
+use super::{decode, encode, syntax_elements::*, Bitstream, BitstreamWriter, ByteSource, Decode, Encode, ProfileTierLevel};
 use std::io;
 
 #[derive(Clone, Debug, Default)]
@@ -9,7 +9,7 @@ pub struct SequenceParameterSetSubLayerOrderingInfo {
 }
 
 impl Decode for SequenceParameterSetSubLayerOrderingInfo {
-    fn decode<T: Iterator<Item = u8>>(bs: &mut Bitstream<T>) -> io::Result<Self> {
+    fn decode<T: ByteSource>(bs: &mut Bitstream<T>) -> io::Result<Self> {
         Ok(Self {
             sps_max_dec_pic_buffering_minus1: UE::decode(bs)?,
             sps_max_num_reorder_pics: UE::decode(bs)?,
@@ -46,7 +46,7 @@ pub struct ShortTermRefPicSet {
 
 #[allow(non_snake_case)]
 impl ShortTermRefPicSet {
-    pub fn decode<T: Iterator<Item = u8>>(bs: &mut Bitstream<T>, st_rps_idx: u64) -> io::Result<Self> {
+    pub fn decode<T: ByteSource>(bs: &mut Bitstream<T>, st_rps_idx: u64) -> io::Result<Self> {
         let mut ret = Self::default();
 
         if st_rps_idx != 0 {
@@ -269,7 +269,7 @@ impl SequenceParameterSet {
 }
 
 impl Decode for SequenceParameterSet {
-    fn decode<T: Iterator<Item = u8>>(bs: &mut Bitstream<T>) -> io::Result<Self> {
+    fn decode<T: ByteSource>(bs: &mut Bitstream<T>) -> io::Result<Self> {
         let mut ret = Self::default();
 
         decode!(
@@ -564,7 +564,7 @@ pub struct VUIParameters {
 pub const ASPECT_RATIO_IDC_EXTENDED_SAR: u8 = 255;
 
 impl Decode for VUIParameters {
-    fn decode<T: Iterator<Item = u8>>(bs: &mut Bitstream<T>) -> io::Result<Self> {
+    fn decode<T: ByteSource>(bs: &mut Bitstream<T>) -> io::Result<Self> {
         let mut ret = Self::default();
 
         decode!(bs, &mut ret.aspect_ratio_info_present_flag)?;
@@ -1,5 +1,6 @@
 use super::{
-    decode, encode, nal_unit::*, syntax_elements::*, Bitstream, BitstreamWriter, Decode, Encode, PictureParameterSet, SequenceParameterSet, ShortTermRefPicSet,
+    decode, encode, nal_unit::*, syntax_elements::*, Bitstream, BitstreamWriter, ByteSource, Decode, Encode, PictureParameterSet, SequenceParameterSet,
+    ShortTermRefPicSet,
 };
 use std::io;
 
@@ -7,7 +8,7 @@ pub const SLICE_TYPE_B: u64 = 0;
 pub const SLICE_TYPE_P: u64 = 1;
 pub const SLICE_TYPE_I: u64 = 2;
 
-#[derive(Debug, Default)]
+#[derive(Clone, Debug, Default)]
 pub struct RefPicListsModification {
     pub ref_pic_list_modification_flag_l0: U1,
 
@@ -28,7 +29,7 @@ fn ceil_log2(n: u64) -> u32 {
 }
 
 impl RefPicListsModification {
-    pub fn decode<T: Iterator<Item = u8>>(
+    pub fn decode<T: ByteSource>(
         bs: &mut Bitstream<T>,
         slice_type: u64,
         #[allow(non_snake_case)] NumPicTotalCurr: u64,
@@ -79,7 +80,7 @@ impl RefPicListsModification {
     }
 }
 
-#[derive(Debug, Default)]
+#[derive(Clone, Debug, Default)]
 pub struct SliceSegmentHeader {
     pub first_slice_segment_in_pic_flag: U1,
 
@@ -205,7 +206,7 @@ pub struct SliceSegmentHeader {
 impl SliceSegmentHeader {
     // TODO: pps should probably be a map so we can find the correct pps based on slice_pic_parameter_set_id
     #[allow(clippy::cognitive_complexity)]
-    pub fn decode<T: Iterator<Item = u8>>(bs: &mut Bitstream<T>, nal_unit_type: u8, sps: &SequenceParameterSet, pps: &PictureParameterSet) -> io::Result<Self> {
+    pub fn decode<T: ByteSource>(bs: &mut Bitstream<T>, nal_unit_type: u8, sps: &SequenceParameterSet, pps: &PictureParameterSet) -> io::Result<Self> {
         if pps.pps_range_extension_flag.0 != 0 {
             return Err(io::Error::new(io::ErrorKind::Other, "the pps range extension is not supported"));
         }
@@ -655,6 +656,11 @@ mod test {
 
             assert_eq!(bs.next_bits(1), None);
 
+            let mut bs = Bitstream::from_source(RBSPSlice::new(&data));
+            let ssh_from_slice = SliceSegmentHeader::decode(&mut bs, 1, &sps, &pps).unwrap();
+            assert_eq!(ssh_from_slice.num_entry_point_offsets.0, 143);
+            assert_eq!(bs.next_bits(1), None);
+
             let mut round_trip = Vec::new();
             ssh.encode(&mut BitstreamWriter::new(&mut round_trip), 1, &sps, &pps).unwrap();
             assert_eq!(round_trip, data);
@@ -0,0 +1,34 @@
+//! Helpers for building H.265 bitstreams in tests. Only available with the `test-util` feature.
+
+use super::{BitstreamWriter, EmulationPrevention, Encode, NALUnitHeader};
+use std::io;
+
+/// Builds a NALU of the given type, adding emulation prevention to the RBSP.
+pub fn nalu(nal_unit_type: u8, rbsp: Vec<u8>) -> Vec<u8> {
+    let mut nalu_header = NALUnitHeader::default();
+    nalu_header.nal_unit_type.0 = nal_unit_type;
+    nalu_header.nuh_temporal_id_plus1.0 = 1;
+    let mut nalu = Vec::new();
+    nalu_header.encode(&mut BitstreamWriter::new(&mut nalu)).unwrap();
+    nalu.extend(&mut EmulationPrevention::new(rbsp));
+    nalu
+}
+
+/// Builds a NALU for a parameter set, including the RBSP trailing bits.
+pub fn parameter_set_nalu<P: Encode>(nal_unit_type: u8, parameter_set: &P) -> Vec<u8> {
+    let mut rbsp = Vec::new();
+    {
+        let mut bs = BitstreamWriter::new(&mut rbsp);
+        parameter_set.encode(&mut bs).unwrap();
+        bs.write_bits(1, 1).unwrap();
+        while !bs.byte_aligned() {
+            bs.write_bits(0, 1).unwrap();
+        }
+    }
+    nalu(nal_unit_type, rbsp)
+}
+
+/// Turns each input's NALUs into the fallible iterators that the tile crates read from.
+pub fn nalu_results(inputs: &[Vec<Vec<u8>>]) -> Vec<impl Iterator<Item = io::Result<&Vec<u8>>>> {
+    inputs.iter().map(|input| input.iter().map(Ok)).collect()
+}
@@ -1,4 +1,4 @@
-use super::{decode, syntax_elements::*, Bitstream, Decode, ProfileTierLevel};
+use super::{decode, syntax_elements::*, Bitstream, ByteSource, Decode, ProfileTierLevel};
 use std::io;
 
 #[derive(Debug, Default)]
@@ -9,7 +9,7 @@ pub struct VideoParameterSetSubLayerOrderingInfo {
 }
 
 impl Decode for VideoParameterSetSubLayerOrderingInfo {
-    fn decode<T: Iterator<Item = u8>>(bs: &mut Bitstream<T>) -> io::Result<Self> {
+    fn decode<T: ByteSource>(bs: &mut Bitstream<T>) -> io::Result<Self> {
         Ok(Self {
             vps_max_dec_pic_buffering_minus1: UE::decode(bs)?,
             vps_max_num_reorder_pics: UE::decode(bs)?,
@@ -49,7 +49,7 @@ pub struct VideoParameterSet {
 }
 
 impl Decode for VideoParameterSet {
-    fn decode<T: Iterator<Item = u8>>(bs: &mut Bitstream<T>) -> io::Result<Self> {
+    fn decode<T: ByteSource>(bs: &mut Bitstream<T>) -> io::Result<Self> {
         let mut ret = Self::default();
 
         decode!(
@@ -0,0 +1,68 @@
+use criterion::{criterion_group, criterion_main, BenchmarkId, Criterion, Throughput};
+use mpeg2::{
+    interleaving_muxer::InterleavingMuxer,
+    muxer::{Packet, StreamConfig},
+};
+use std::{io, time::Duration};
+
+const SECONDS: u64 = 2;
+
+/// Returns the order in which a muxer would receive packets from the given number of streams, each
+/// producing `rate` packets per second. Every stream hands over 100ms worth of packets at a time,
+/// so at any point some streams lead and some lag.
+fn schedule(streams: usize, rate: u64) -> Vec<(usize, u64)> {
+    let mut ret = vec![];
+    for window in 0..SECONDS * 10 {
+        for stream in 0..streams {
+            let first = window * rate / 10;
+            let last = (window + 1) * rate / 10;
+            ret.extend((first..last).map(|n| (stream, 90_000 + n * 90_000 / rate + stream as u64 * 7)));
+        }
+    }
+    ret
+}
+
+fn criterion_benchmark(c: &mut Criterion) {
+    let payload = vec![0; 64];
+
+    let mut group = c.benchmark_group("interleaving_muxer");
+    // the muxer writes its pmt as a single packet, which limits it to around 34 streams
+    for &rate in &[50, 500] {
+        for &streams in &[2, 8, 16, 32] {
+            let schedule = schedule(streams, rate);
+            group.throughput(Throughput::Elements(schedule.len() as u64));
+            group.bench_with_input(BenchmarkId::new(format!("{}_pps", rate), streams), &schedule, |b, schedule| {
+                b.iter(|| {
+                    let mut muxer = InterleavingMuxer::new(io::sink(), Duration::from_millis(500));
+                    for _ in 0..streams {
+                        muxer.add_stream(StreamConfig {
+                            stream_id: 0xc0,
+                            stream_type: 0x0f,
+                            data: vec![],
+                            unbounded_data_length: false,
+                        });
+                    }
+                    for &(stream, ts) in schedule {
+                        muxer
+                            .write(
+                                stream,
+                                Packet {
+                                    data: payload.as_slice().into(),
+                                    random_access_indicator: false,
+                                    pts_90khz: Some(ts),
+                                    dts_90khz: None,
+                                    temi_timeline_descriptors: vec![],
+                                },
+                            )
+                            .unwrap();
+                    }
+                    muxer.flush().unwrap();
+                })
+            });
+        }
+    }
+    group.finish();
+}
+
+criterion_group!(benches, criterion_benchmark);
+criterion_main!(benches);
@@ -1,7 +1,8 @@
 use super::EncodeError;
 use crate::muxer::{Muxer, Packet, Stream, StreamConfig};
-use alloc::collections::vec_deque::VecDeque;
+use alloc::collections::{binary_heap::BinaryHeap, vec_deque::VecDeque};
 use alloc::vec::Vec;
+use core::cmp::Reverse;
 use core::time::Duration;
 use core2::io::Write;
 
@@ -12,12 +13,17 @@ pub struct InterleavingMuxer<W: Write> {
     max_buffer_duration_90khz: u64,
     largest_ts_in_buffer: u64,
     streams: Vec<InterleavingStream>,
+    /// The timestamp and stream index of the first buffered packet of every stream that has any.
+    /// The earliest one is on top, with ties going to the lowest stream index.
+    heads: BinaryHeap<Reverse<(u64, usize)>>,
     last_fixed_timestamp: u64,
 }
 
 pub struct InterleavingStream {
     inner: Stream,
-    buffered_packets: VecDeque<(usize, u64, Option<Packet<'static>>)>,
+    /// Packets that are waiting on other streams. A packet of `None` is a placeholder for the one
+    /// currently being written, which is only copied into the buffer if it can't be emitted right away.
+    buffered_packets: VecDeque<(u64, Option<Packet<'static>>)>,
     last_written_ts: u64,
 }
 
@@ -29,6 +35,7 @@ impl<W: Write> InterleavingMuxer<W> {
             max_buffer_duration_90khz: (max_buffer_duration.as_millis() * 90) as u64,
             largest_ts_in_buffer: 0,
             streams: vec![],
+            heads: BinaryHeap::new(),
             last_fixed_timestamp: 0,
         }
     }
@@ -87,126 +94,134 @@ impl<W: Write> InterleavingMuxer<W> {
         Ok(())
     }
 
-    fn emit_packets_outside_buffer_duration(&mut self) -> Result<(), EncodeError> {
-        let mut packets = vec![];
-        for (stream_index, stream) in self.streams.iter_mut().enumerate() {
-            while let Some(p) = stream.buffered_packets.front() {
-                let ts = p.1;
-                if self.largest_ts_in_buffer - ts > self.max_buffer_duration_90khz {
-                    packets.push((
-                        stream_index,
-                        ts,
-                        stream.buffered_packets.pop_front().expect("there must be at least one packet to pop"),
-                    ));
-                } else {
+    fn push_buffered_packet(&mut self, stream_index: usize, ts: u64, p: Option<Packet<'static>>) {
+        let buffered_packets = &mut self.streams[stream_index].buffered_packets;
+        if buffered_packets.is_empty() {
+            self.heads.push(Reverse((ts, stream_index)));
+        }
+        buffered_packets.push_back((ts, p));
+    }
+
+    /// Repeatedly takes the stream with the earliest buffered packet and emits its packets up to
+    /// the timestamp returned by `max_ts`, which is given the timestamp of that packet, the earliest
+    /// timestamp buffered by any other stream, and whether every stream has packets buffered. Stops
+    /// once `max_ts` returns `None`. If the placeholder for `pending` is reached, `pending` is
+    /// written in its place.
+    fn emit_buffered_packets<F: Fn(u64, Option<u64>, bool) -> Option<u64>>(&mut self, max_ts: F, pending: &mut Option<Packet>) -> Result<(), EncodeError> {
+        while let Some(&Reverse((head_ts, stream_index))) = self.heads.peek() {
+            let all_streams_buffered = self.heads.len() == self.streams.len();
+            self.heads.pop();
+            let next_head_ts = self.heads.peek().map(|&Reverse((ts, _))| ts);
+            let max_ts = match max_ts(head_ts, next_head_ts, all_streams_buffered) {
+                Some(max_ts) => max_ts,
+                None => {
+                    self.heads.push(Reverse((head_ts, stream_index)));
+                    return Ok(());
+                }
+            };
+
+            let mut result = Ok(());
+            while let Some(&(ts, _)) = self.streams[stream_index].buffered_packets.front() {
+                if ts > max_ts {
+                    break;
+                }
+                let (ts, packet) = self.streams[stream_index]
+                    .buffered_packets
+                    .pop_front()
+                    .expect("there must be at least one packet to pop");
+                if let Some(p) = packet.or_else(|| pending.take()) {
+                    result = self.write_muxer_packet(stream_index, p);
+                }
+                self.streams[stream_index].last_written_ts = ts;
+                if result.is_err() {
                     break;
                 }
             }
-        }
-        for (stream_index, ts, packet) in packets {
-            if let Some(p) = packet.2 {
-                self.write_muxer_packet(stream_index, p)?;
+            if let Some(&(ts, _)) = self.streams[stream_index].buffered_packets.front() {
+                self.heads.push(Reverse((ts, stream_index)));
             }
-            self.streams[stream_index].last_written_ts = ts;
+            result?;
         }
         Ok(())
     }
 
     fn emit_packets(&mut self, index: usize, p: Packet, ts: u64) -> Result<(), EncodeError> {
-        self.streams[index].buffered_packets.push_back((index, ts, None));
-        let mut enqueue_packet = true;
-
-        // emit packets outsize max buffer duration
-        self.emit_packets_outside_buffer_duration()?;
-
-        let mut packets = vec![];
-        loop {
-            let mut last_written_ts = 0;
-            let mut min_ts_stream_index = 0;
-            // find a stream with smallest packet timestamp and emit all packets in this stream if packets
-            // in all other streams with timestamps are larger
-            let mut emit_packets_found = false;
-            if let Some((i, _)) = self
-                .streams
-                .iter()
-                .enumerate()
-                .min_by_key(|(_, s)| if let Some(p) = s.buffered_packets.front() { p.1 } else { 0 })
-            {
-                if !self.streams[i].buffered_packets.is_empty() {
-                    let others_min_ts = self.min_ts_excluding(i);
-                    let stream = &mut self.streams[i];
-                    min_ts_stream_index = i;
-                    while let Some(first_packet) = stream.buffered_packets.front() {
-                        let first_packet_ts = first_packet.1;
-                        if first_packet_ts <= others_min_ts {
-                            let first_packet = stream.buffered_packets.pop_front().expect("there must be at least one packet to pop");
-                            if first_packet.2.is_none() {
-                                enqueue_packet = false;
-                            }
-                            packets.push(first_packet);
-                            last_written_ts = first_packet_ts;
-                            emit_packets_found = true;
-                        } else {
-                            break;
-                        }
-                    }
+        self.push_buffered_packet(index, ts, None);
+        let mut pending = Some(p);
+
+        // emit packets outside max buffer duration
+        let largest_ts_in_buffer = self.largest_ts_in_buffer;
+        let max_buffer_duration_90khz = self.max_buffer_duration_90khz;
+        self.emit_buffered_packets(
+            |head_ts, next_head_ts, _| {
+                if largest_ts_in_buffer - head_ts > max_buffer_duration_90khz {
+                    let max_ts = largest_ts_in_buffer - max_buffer_duration_90khz - 1;
+                    Some(next_head_ts.map_or(max_ts, |next_head_ts| next_head_ts.min(max_ts)))
+                } else {
+                    None
                 }
-            }
-            if emit_packets_found {
-                self.streams[min_ts_stream_index].last_written_ts = last_written_ts;
-            } else {
-                break;
-            }
-        }
-
-        for (i, packet_ts, packet) in packets {
-            if let Some(p) = packet {
-                self.write_muxer_packet(i, p)?;
-                self.streams[i].last_written_ts = packet_ts;
-            }
-        }
-        if enqueue_packet {
-            self.streams[index].buffered_packets.pop_back();
-            self.streams[index].buffered_packets.push_back((index, ts, Some(p.into_owned())));
-        } else {
-            self.write_muxer_packet(index, p)?;
+            },
+            &mut None,
+        )?;
+
+        // emit packets that come before everything buffered by the other streams. a stream without
+        // any buffered packets could get a packet with any timestamp next, so once any stream runs
+        // dry, only packets with a timestamp of zero can go
+        self.emit_buffered_packets(
+            |head_ts, next_head_ts, all_streams_buffered| {
+                if all_streams_buffered {
+                    Some(next_head_ts.unwrap_or(u64::MAX))
+                } else if head_ts == 0 {
+                    Some(0)
+                } else {
+                    None
+                }
+            },
+            &mut pending,
+        )?;
+
+        if let Some(p) = pending {
+            let placeholder = self.streams[index]
+                .buffered_packets
+                .back_mut()
+                .expect("the placeholder should still be buffered");
+            placeholder.1 = Some(p.into_owned());
         }
 
         Ok(())
     }
 
-    fn min_ts_excluding(&self, stream_id: usize) -> u64 {
-        let mut min_ts = u64::MAX;
-        for (_, stream) in self.streams.iter().enumerate().filter(|&(index, _)| index != stream_id) {
-            if let Some(p) = stream.buffered_packets.front() {
-                min_ts = min_ts.min(p.1);
-            } else {
-                min_ts = 0;
-                break;
+    /// Returns the earliest timestamp buffered by any stream other than the given one. Streams
+    /// without any buffered packets count as zero.
+    fn min_ts_excluding(&mut self, stream_id: usize) -> u64 {
+        let mut empty_streams = self.streams.len() - self.heads.len();
+        if self.streams[stream_id].buffered_packets.is_empty() {
+            empty_streams -= 1;
+        }
+        if empty_streams > 0 {
+            return 0;
+        }
+        match self.heads.peek() {
+            Some(&Reverse((_, i))) if i == stream_id => {
+                let head = self.heads.pop().expect("there must be a head to pop");
+                let min_ts = self.heads.peek().map_or(u64::MAX, |&Reverse((ts, _))| ts);
+                self.heads.push(head);
+                min_ts
             }
+            Some(&Reverse((ts, _))) => ts,
+            None => u64::MAX,
         }
-        min_ts
     }
 
     pub fn flush(&mut self) -> Result<(), EncodeError> {
         self.largest_ts_in_buffer = 0;
 
-        let mut packets = vec![];
-        self.streams.iter_mut().enumerate().for_each(|(stream_index, stream)| {
-            while let Some(p) = stream.buffered_packets.pop_front() {
-                packets.push((stream_index, p));
-            }
+        // when emit_packets returns an error, it's possible that the None packets are still in the buffer,
+        let result = self.emit_buffered_packets(|_, next_head_ts, _| Some(next_head_ts.unwrap_or(u64::MAX)), &mut None);
+        for stream in &mut self.streams {
             stream.last_written_ts = 0;
-        });
-
-        packets.sort_unstable_by_key(|(_, p)| p.0);
-        for (stream_index, packet) in packets {
-            // when emit_packets returns an error, it's possible that the None packets are still in the buffer,
-            if let Some(packet) = packet.2 {
-                self.write_muxer_packet(stream_index, packet)?;
-            }
         }
-        Ok(())
+        result
     }
 }
 
@@ -599,6 +614,31 @@ mod test {
         );
     }
 
+    /// With many streams that each hand over packets in bursts, everything should still come out
+    /// in timestamp order.
+    #[test]
+    fn test_many_streams() {
+        let w = TestWriter::new();
+        let mut muxer = InterleavingMuxer::new(&w, Duration::from_millis(500));
+        add_streams(&mut muxer, 17);
+
+        for burst in 0..10 {
+            for stream_index in 0..17 {
+                for n in 0..4 {
+                    let pts = 1000 + (burst * 4 + n) * 900 + stream_index as u64;
+                    muxer.write(stream_index, simple_packet(pts)).unwrap();
+                }
+            }
+        }
+        muxer.flush().unwrap();
+
+        let packets = w.packets();
+        assert_eq!(packets.len(), 10 * 17 * 4);
+        for i in 1..packets.len() {
+            assert!(packets[i - 1].pts_90khz < packets[i].pts_90khz);
+        }
+    }
+
     #[test]
     fn test_oversized_presentation_times() {
         let w = TestWriter::new();
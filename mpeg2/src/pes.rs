@@ -20,6 +20,14 @@ pub struct PacketizationConfig {
 }
 
 impl<'a> Packet<'a> {
+    /// Converts the packet into one that owns its data, copying it if necessary.
+    pub fn into_owned(self) -> Packet<'static> {
+        Packet {
+            header: self.header,
+            data: Cow::Owned(self.data.into_owned()),
+        }
+    }
+
     pub fn packetize(&self, config: PacketizationConfig) -> Packetize {
         Packetize {
             header: Some(&self.header),
@@ -243,9 +251,15 @@ impl OptionalHeader {
     }
 }
 
+/// Stream reassembles PES packets from transport stream packets.
+///
+/// The payload of the packet being reassembled is accumulated in a buffer that is reused for
+/// every packet in the stream, so once the buffer has grown to the size of the largest packet,
+/// reassembly via `write_with` and `flush_with` doesn't allocate.
 #[derive(Clone)]
 pub struct Stream {
-    pending: Option<Packet<'static>>,
+    pending_header: Option<PacketHeader>,
+    buffer: Vec<u8>,
 }
 
 impl Default for Stream {
@@ -256,56 +270,93 @@ impl Default for Stream {
 
 impl Stream {
     pub fn new() -> Self {
-        Self { pending: None }
+        Self {
+            pending_header: None,
+            buffer: Vec::new(),
+        }
     }
 
     /// Writes transport packets to the stream. Whenever a PES packet is completed, it is returned.
     pub fn write(&mut self, packet: &ts::Packet) -> Result<Vec<Packet<'static>>, DecodeError> {
         let mut completed = Vec::new();
+        self.write_with(packet, |packet| -> Result<(), DecodeError> {
+            completed.push(packet.into_owned());
+            Ok(())
+        })?;
+        Ok(completed)
+    }
 
+    /// Writes transport packets to the stream. Whenever a PES packet is completed, it is passed to
+    /// `f`. The packet's data is borrowed from the stream's internal buffer, which is reused for the
+    /// next packet, so `f` must copy anything it needs to keep.
+    pub fn write_with<E, F>(&mut self, packet: &ts::Packet, mut f: F) -> Result<(), E>
+    where
+        E: From<DecodeError>,
+        F: FnMut(Packet<'_>) -> Result<(), E>,
+    {
         if let Some(payload) = &packet.payload {
             if packet.payload_unit_start_indicator {
-                if let Some(pending) = self.pending.take() {
-                    if pending.header.data_length == 0 {
-                        completed.push(pending);
-                    }
-                }
-
+                let completed = match self.pending_header.take() {
+                    Some(header) if header.data_length == 0 => f(Packet {
+                        header,
+                        data: Cow::Borrowed(&self.buffer),
+                    }),
+                    _ => Ok(()),
+                };
+
+                // Start on the new packet even if the completed one was rejected, so that one bad
+                // packet doesn't take the next one down with it.
                 let (header, header_size) = PacketHeader::decode(payload)?;
-                self.pending = Some(Packet {
-                    header,
-                    data: payload[header_size..].to_vec().into(),
-                })
-            } else if let Some(pending) = &mut self.pending {
-                pending.data.to_mut().extend_from_slice(payload);
+                self.pending_header = Some(header);
+                self.buffer.clear();
+                self.buffer.extend_from_slice(&payload[header_size..]);
+                completed?;
+            } else if self.pending_header.is_some() {
+                self.buffer.extend_from_slice(payload);
             }
         }
 
-        if match &self.pending {
-            Some(pending) => pending.header.data_length > 0 && pending.data.len() >= pending.header.data_length,
+        if match &self.pending_header {
+            Some(header) => header.data_length > 0 && self.buffer.len() >= header.data_length,
             None => false,
         } {
-            if let Some(mut pending) = self.pending.take() {
-                if pending.header.data_length > 0 {
-                    pending.data.to_mut().truncate(pending.header.data_length);
-                }
-                completed.push(pending);
+            if let Some(header) = self.pending_header.take() {
+                let data_length = header.data_length;
+                f(Packet {
+                    header,
+                    data: Cow::Borrowed(&self.buffer[..data_length]),
+                })?;
             }
         }
 
-        Ok(completed)
+        Ok(())
     }
 
     pub fn flush(&mut self) -> Vec<Packet<'static>> {
         let mut completed = Vec::new();
+        self.flush_with(|packet| -> Result<(), DecodeError> {
+            completed.push(packet.into_owned());
+            Ok(())
+        })
+        .expect("collecting packets should never fail");
+        completed
+    }
 
-        if let Some(pending) = self.pending.take() {
-            if pending.header.data_length == 0 {
-                completed.push(pending);
+    /// Completes any pending packet of unbounded length, passing it to `f`. Like `write_with`, the
+    /// packet's data is borrowed from the stream's internal buffer.
+    pub fn flush_with<E, F>(&mut self, mut f: F) -> Result<(), E>
+    where
+        F: FnMut(Packet<'_>) -> Result<(), E>,
+    {
+        if let Some(header) = self.pending_header.take() {
+            if header.data_length == 0 {
+                f(Packet {
+                    header,
+                    data: Cow::Borrowed(&self.buffer),
+                })?;
             }
         }
-
-        completed
+        Ok(())
     }
 }
 
@@ -368,4 +419,89 @@ mod test {
         assert_eq!(encoded[3], 0b00110001);
         assert_eq!(encoded[8], 0b00010001);
     }
+
+    #[test]
+    fn test_stream_reassembly() {
+        for &data_length in &[0, 1000] {
+            let packet = Packet {
+                header: PacketHeader {
+                    stream_id: 0xe0,
+                    optional_header: Some(OptionalHeader {
+                        data_alignment_indicator: true,
+                        pts: Some(1234),
+                        dts: None,
+                    }),
+                    data_length,
+                },
+                data: (0..1000).map(|i| i as u8).collect::<Vec<u8>>().into(),
+            };
+
+            let mut stream = Stream::new();
+            let mut completed = Vec::new();
+            for _ in 0..2 {
+                for ts_packet in packet.packetize(Default::default()) {
+                    stream
+                        .write_with(&ts_packet, |p| -> Result<(), DecodeError> {
+                            completed.push(p.into_owned());
+                            Ok(())
+                        })
+                        .unwrap();
+                }
+            }
+            completed.extend(stream.flush());
+
+            assert_eq!(completed.len(), 2);
+            for p in completed {
+                assert_eq!(p.header.optional_header, packet.header.optional_header);
+                assert_eq!(p.data, packet.data);
+            }
+        }
+    }
+
+    #[test]
+    fn test_stream_reassembly_after_error() {
+        for &data_length in &[0, 1000] {
+            let packets: Vec<_> = (0..3u8)
+                .map(|n| Packet {
+                    header: PacketHeader {
+                        stream_id: 0xe0,
+                        optional_header: Some(OptionalHeader {
+                            data_alignment_indicator: true,
+                            pts: Some(n as u64),
+                            dts: None,
+                        }),
+                        data_length,
+                    },
+                    data: (0..1000).map(|i| (i as u8).wrapping_add(n)).collect::<Vec<u8>>().into(),
+                })
+                .collect();
+
+            // the first packet is rejected, but the ones after it should still come through intact
+            let mut stream = Stream::new();
+            let mut completed = Vec::new();
+            let mut errors = 0;
+            for packet in &packets {
+                for ts_packet in packet.packetize(Default::default()) {
+                    let result = stream.write_with(&ts_packet, |p| -> Result<(), DecodeError> {
+                        if p.header.optional_header.as_ref().and_then(|h| h.pts) == Some(0) {
+                            return Err(DecodeError::new("rejected"));
+                        }
+                        completed.push(p.into_owned());
+                        Ok(())
+                    });
+                    if result.is_err() {
+                        errors += 1;
+                    }
+                }
+            }
+            completed.extend(stream.flush());
+
+            assert_eq!(errors, 1);
+            assert_eq!(completed.len(), 2);
+            for (p, expected) in completed.iter().zip(&packets[1..]) {
+                assert_eq!(p.header.optional_header, expected.header.optional_header);
+                assert_eq!(p.data, expected.data);
+            }
+        }
+    }
 }
@@ -1,20 +1,184 @@
-use criterion::{criterion_group, criterion_main, Criterion};
-use mpeg2::ts;
-use std::{fs::File, io::Read};
+use criterion::{criterion_group, criterion_main, BenchmarkId, Criterion};
+use mpeg2::{pes, ts};
+use mpegts_segmenter::{Analyzer, AnalyzerConfig, MemorySegmentStorage, Segmenter, SegmenterConfig};
+use std::{collections::HashMap, fs::File, io::Read, time::Duration};
+
+fn read_test_file(path: &str) -> Vec<u8> {
+    let mut f = File::open(path).unwrap();
+    let mut buf = Vec::new();
+    f.read_to_end(&mut buf).unwrap();
+    buf
+}
+
+struct VideoCodec {
+    nal_unit_type: fn(&[u8]) -> u8,
+    aud: u8,
+    parameter_sets: &'static [u8],
+}
+
+fn h264_nal_unit_type(nalu: &[u8]) -> u8 {
+    nalu.first().map_or(0, |b| b & 0x1f)
+}
+
+fn h265_nal_unit_type(nalu: &[u8]) -> u8 {
+    nalu.first().map_or(0, |b| (b >> 1) & 0x3f)
+}
+
+const H264: VideoCodec = VideoCodec {
+    nal_unit_type: h264_nal_unit_type,
+    aud: 9,
+    parameter_sets: &[7, 8],
+};
+
+const H265: VideoCodec = VideoCodec {
+    nal_unit_type: h265_nal_unit_type,
+    aud: 35,
+    parameter_sets: &[32, 33, 34],
+};
+
+/// Rewrites a transport stream so that every video PES packet carries the most recent parameter
+/// sets, the way some encoders repeat them on every frame. The test files only send them once per
+/// GOP, which leaves `AnalyzerConfig::incremental` with almost nothing to skip.
+fn repeat_parameter_sets(buf: &[u8], codec: &VideoCodec) -> Vec<u8> {
+    let mut streams: HashMap<u16, (pes::Stream, u8)> = HashMap::new();
+    let mut parameter_sets: Vec<Vec<u8>> = Vec::new();
+    let mut out = Vec::with_capacity(buf.len() * 2);
+
+    let mut write_pes = |packet: pes::Packet<'_>, packet_id: u16, continuity_counter: &mut u8, out: &mut Vec<u8>| {
+        let nalus: Vec<&[u8]> = h264::iterate_annex_b(&packet.data).collect();
+        let is_parameter_set = |nalu: &[u8]| codec.parameter_sets.contains(&(codec.nal_unit_type)(nalu));
+        let packet = if nalus.iter().any(|nalu| is_parameter_set(nalu)) {
+            parameter_sets = nalus.iter().filter(|nalu| is_parameter_set(nalu)).map(|nalu| nalu.to_vec()).collect();
+            packet
+        } else {
+            // the parameter sets go right after the access unit delimiter, if there is one
+            let split = nalus.iter().take_while(|nalu| (codec.nal_unit_type)(nalu) == codec.aud).count();
+            let mut data = Vec::with_capacity(packet.data.len() + parameter_sets.iter().map(|nalu| nalu.len() + 4).sum::<usize>());
+            for nalu in nalus[..split]
+                .iter()
+                .copied()
+                .chain(parameter_sets.iter().map(|nalu| nalu.as_slice()))
+                .chain(nalus[split..].iter().copied())
+            {
+                data.extend_from_slice(&[0, 0, 0, 1]);
+                data.extend_from_slice(nalu);
+            }
+            let mut header = packet.header;
+            if header.data_length > 0 {
+                header.data_length = data.len();
+            }
+            pes::Packet { header, data: data.into() }
+        };
+
+        for ts_packet in packet.packetize(pes::PacketizationConfig {
+            packet_id,
+            continuity_counter: *continuity_counter,
+            ..Default::default()
+        }) {
+            if ts_packet.payload.is_some() {
+                *continuity_counter = (*continuity_counter + 1) % 16;
+            }
+            ts_packet.encode(&mut *out).unwrap();
+        }
+    };
+
+    for raw in buf.chunks(ts::PACKET_LENGTH) {
+        let packet = ts::Packet::decode(raw).unwrap();
+        let starts_video_pes = packet.payload_unit_start_indicator
+            && matches!(&packet.payload, Some(payload) if payload.len() > 3 && payload[..3] == [0, 0, 1] && payload[3] & 0xf0 == 0xe0);
+        if starts_video_pes {
+            streams.entry(packet.packet_id).or_insert_with(|| (pes::Stream::new(), 0));
+        }
+        match streams.get_mut(&packet.packet_id) {
+            Some((stream, continuity_counter)) => {
+                for pes_packet in stream.write(&packet).unwrap() {
+                    write_pes(pes_packet, packet.packet_id, continuity_counter, &mut out);
+                }
+            }
+            None => out.extend_from_slice(raw),
+        }
+    }
+    for (&packet_id, (stream, continuity_counter)) in &mut streams {
+        for pes_packet in stream.flush() {
+            write_pes(pes_packet, packet_id, continuity_counter, &mut out);
+        }
+    }
+    out
+}
 
 fn criterion_benchmark(c: &mut Criterion) {
-    c.bench_function("analyzer", |b| {
-        let mut f = File::open("src/testdata/h264-8k.ts").unwrap();
-        let mut buf = Vec::new();
-        f.read_to_end(&mut buf).unwrap();
-        let packets = ts::decode_packets(&buf).unwrap();
-
-        b.iter(|| {
-            let mut analyzer = mpegts_segmenter::Analyzer::new();
-            analyzer.handle_packets(&packets).unwrap();
-            analyzer.flush().unwrap();
-        })
-    });
+    let analyzer_configs = [
+        ("analyzer", AnalyzerConfig::default()),
+        (
+            "analyzer_full_decode",
+            AnalyzerConfig {
+                incremental: false,
+                ..Default::default()
+            },
+        ),
+        (
+            "analyzer_resolution_only",
+            AnalyzerConfig {
+                frame_rate: false,
+                frame_count: false,
+                timecodes: false,
+                incremental: true,
+            },
+        ),
+    ];
+    for &(name, config) in &analyzer_configs {
+        c.bench_function(name, |b| {
+            let buf = read_test_file("src/testdata/h264-8k.ts");
+            let packets = ts::decode_packets(&buf).unwrap();
+
+            b.iter(|| {
+                let mut analyzer = Analyzer::with_config(config);
+                analyzer.handle_packets(&packets).unwrap();
+                analyzer.flush().unwrap();
+            })
+        });
+    }
+
+    {
+        let mut group = c.benchmark_group("analyzer_repeated_parameter_sets");
+        for &(file, codec) in &[("h264-8k", &H264), ("h265", &H265)] {
+            let buf = repeat_parameter_sets(&read_test_file(&format!("src/testdata/{}.ts", file)), codec);
+            let packets = ts::decode_packets(&buf).unwrap();
+            for &(name, config) in &analyzer_configs {
+                group.bench_function(BenchmarkId::new(name, file), |b| {
+                    b.iter(|| {
+                        let mut analyzer = Analyzer::with_config(config);
+                        analyzer.handle_packets(&packets).unwrap();
+                        analyzer.flush().unwrap();
+                    })
+                });
+            }
+        }
+        group.finish();
+    }
+
+    let rt = tokio::runtime::Runtime::new().unwrap();
+
+    for &(name, chunk_size) in &[("segmenter_srt_chunks", ts::PACKET_LENGTH * 7), ("segmenter_whole_buffer", usize::MAX)] {
+        c.bench_function(name, |b| {
+            let buf = read_test_file("src/testdata/h264-8k.ts");
+
+            b.iter(|| {
+                rt.block_on(async {
+                    let mut segmenter = Segmenter::new(
+                        SegmenterConfig {
+                            min_segment_duration: Duration::from_secs(1),
+                        },
+                        MemorySegmentStorage::new(),
+                    );
+                    for chunk in buf.chunks(chunk_size.min(buf.len())) {
+                        segmenter.write(chunk).await.unwrap();
+                    }
+                    segmenter.flush().await.unwrap();
+                })
+            })
+        });
+    }
 }
 
 criterion_group!(benches, criterion_benchmark);
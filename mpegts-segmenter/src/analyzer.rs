@@ -1,7 +1,7 @@
 use mpeg2::{pes, ts};
 use mpeg4::AudioDataTransportStream;
 
-use std::{collections::VecDeque, error::Error};
+use std::{collections::VecDeque, error::Error, mem};
 
 pub type Result<T> = std::result::Result<T, Box<dyn Error + Send + Sync>>;
 
@@ -13,6 +13,35 @@ pub struct Timecode {
     pub frames: u8,
 }
 
+/// AnalyzerConfig determines which outputs the analyzer computes. Outputs that aren't needed can
+/// be disabled, allowing the parsing that they require to be skipped.
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+pub struct AnalyzerConfig {
+    /// If true, video frame rates are read from the parameter sets or, failing that, guessed via
+    /// the PES timestamps. Otherwise they're reported as 0.
+    pub frame_rate: bool,
+    /// If true, video access units are counted, which requires decoding slice headers. Otherwise
+    /// frame counts are reported as 0.
+    pub frame_count: bool,
+    /// If true, H.264 timecodes are decoded from SEI picture timing messages.
+    pub timecodes: bool,
+    /// If true, parameter sets are only decoded if their bytes differ from the last ones seen on
+    /// the stream. Encoders typically repeat them on every keyframe or even every frame, so this
+    /// avoids a lot of redundant work without changing any of the outputs.
+    pub incremental: bool,
+}
+
+impl Default for AnalyzerConfig {
+    fn default() -> Self {
+        Self {
+            frame_rate: true,
+            frame_count: true,
+            timecodes: true,
+            incremental: true,
+        }
+    }
+}
+
 #[allow(clippy::large_enum_variant)]
 #[derive(Clone)]
 pub enum Stream {
@@ -36,6 +65,9 @@ pub enum Stream {
         last_timecode: Option<Timecode>,
         last_vui_parameters: Option<h264::VUIParameters>,
         pts_analyzer: PTSAnalyzer,
+        config: AnalyzerConfig,
+        /// The raw bytes of the last SPS that was decoded if the config is incremental.
+        last_sps: Vec<u8>,
     },
     HEVCVideo {
         pes: pes::Stream,
@@ -45,6 +77,13 @@ pub enum Stream {
         rfc6381_codec: Option<String>,
         access_unit_counter: h265::AccessUnitCounter,
         pts_analyzer: PTSAnalyzer,
+        config: AnalyzerConfig,
+        /// The raw bytes of the last SPS and VPS that were decoded if the config is incremental,
+        /// along with the frame rates they specified.
+        last_sps: Vec<u8>,
+        sps_frame_rate: f64,
+        last_vps: Vec<u8>,
+        vps_frame_rate: Option<f64>,
     },
     Other(u8),
 }
@@ -77,11 +116,12 @@ impl Stream {
                 rfc6381_codec,
                 timecode,
                 pts_analyzer,
+                config,
                 ..
             } => StreamInfo::Video {
                 width: *width,
                 height: *height,
-                frame_rate: if *frame_rate != 0.0 {
+                frame_rate: if *frame_rate != 0.0 || !config.frame_rate {
                     *frame_rate
                 } else {
                     pts_analyzer.guess_frame_rate().unwrap_or(0.0)
@@ -102,11 +142,12 @@ impl Stream {
                 access_unit_counter,
                 rfc6381_codec,
                 pts_analyzer,
+                config,
                 ..
             } => StreamInfo::Video {
                 width: *width,
                 height: *height,
-                frame_rate: if *frame_rate != 0.0 {
+                frame_rate: if *frame_rate != 0.0 || !config.frame_rate {
                     *frame_rate
                 } else {
                     pts_analyzer.guess_frame_rate().unwrap_or(0.0)
@@ -153,11 +194,15 @@ impl Stream {
                 last_timecode,
                 last_vui_parameters,
                 pts_analyzer,
+                config,
+                last_sps,
                 ..
             } => {
-                match packet.header.optional_header.and_then(|h| h.pts) {
-                    Some(pts) => pts_analyzer.write_pts(pts),
-                    None => pts_analyzer.reset(),
+                if config.frame_rate {
+                    match packet.header.optional_header.and_then(|h| h.pts) {
+                        Some(pts) => pts_analyzer.write_pts(pts),
+                        None => pts_analyzer.reset(),
+                    }
                 }
 
                 use h264::Decode;
@@ -167,20 +212,26 @@ impl Stream {
                         continue;
                     }
 
-                    access_unit_counter.count_nalu(&nalu)?;
+                    if config.frame_count {
+                        access_unit_counter.count_nalu(&nalu)?;
+                    }
 
                     let nalu_type = nalu[0] & h264::NAL_UNIT_TYPE_MASK;
                     match nalu_type {
                         h264::NAL_UNIT_TYPE_SEQUENCE_PARAMETER_SET => {
-                            let bs = h264::Bitstream::new(nalu.iter().copied());
-                            let mut nalu = h264::NALUnit::decode(bs)?;
-                            *rfc6381_codec = rfc6381::codec_from_h264_nalu(nalu.clone());
-                            let mut rbsp = h264::Bitstream::new(&mut nalu.rbsp_byte);
-                            let sps = h264::SequenceParameterSet::decode(&mut rbsp)?;
+                            // Everything derived here comes from the SPS alone, so a repeat of the
+                            // last one has nothing new to tell us.
+                            if config.incremental && last_sps.as_slice() == nalu {
+                                continue;
+                            }
+                            let sps_nalu = h264::NALUnit::decode_slice(nalu)?;
+                            let sps = h264::SequenceParameterSet::decode(&mut sps_nalu.rbsp_byte.bitstream())?;
+                            *rfc6381_codec = Some(rfc6381::codec_from_h264_sps(&sps));
                             *is_interlaced = sps.frame_mbs_only_flag.0 == 0;
                             *width = sps.frame_cropping_rectangle_width() as _;
                             *height = sps.frame_cropping_rectangle_height() as _;
-                            if sps.vui_parameters_present_flag.0 != 0
+                            if config.frame_rate
+                                && sps.vui_parameters_present_flag.0 != 0
                                 && sps.vui_parameters.timing_info_present_flag.0 != 0
                                 && sps.vui_parameters.num_units_in_tick.0 != 0
                             {
@@ -190,15 +241,19 @@ impl Stream {
                                 // if the frame rate is later requested we'll try to guess it via the PTS analyzer
                                 *frame_rate = 0.0;
                             }
-                            *last_vui_parameters = Some(sps.vui_parameters);
+                            if config.timecodes {
+                                *last_vui_parameters = Some(sps.vui_parameters);
+                            }
+                            if config.incremental {
+                                last_sps.clear();
+                                last_sps.extend_from_slice(nalu);
+                            }
                         }
-                        h264::NAL_UNIT_TYPE_SUPPLEMENTAL_ENHANCEMENT_INFORMATION => {
-                            let bs = h264::Bitstream::new(nalu.iter().copied());
-                            let mut nalu = h264::NALUnit::decode(bs)?;
+                        h264::NAL_UNIT_TYPE_SUPPLEMENTAL_ENHANCEMENT_INFORMATION if config.timecodes => {
+                            let nalu = h264::NALUnit::decode_slice(nalu)?;
 
                             if let Some(vui_params) = &last_vui_parameters {
-                                let mut rbsp = h264::Bitstream::new(&mut nalu.rbsp_byte);
-                                let sei = h264::SEI::decode(&mut rbsp)?;
+                                let sei = h264::SEI::decode(&mut nalu.rbsp_byte.bitstream())?;
 
                                 let mut pic_timings = vec![];
                                 for message in sei.sei_message {
@@ -252,11 +307,18 @@ impl Stream {
                 rfc6381_codec,
                 access_unit_counter,
                 pts_analyzer,
+                config,
+                last_sps,
+                sps_frame_rate,
+                last_vps,
+                vps_frame_rate,
                 ..
             } => {
-                match packet.header.optional_header.and_then(|h| h.pts) {
-                    Some(pts) => pts_analyzer.write_pts(pts),
-                    None => pts_analyzer.reset(),
+                if config.frame_rate {
+                    match packet.header.optional_header.and_then(|h| h.pts) {
+                        Some(pts) => pts_analyzer.write_pts(pts),
+                        None => pts_analyzer.reset(),
+                    }
                 }
 
                 use h265::Decode;
@@ -266,41 +328,61 @@ impl Stream {
                         continue;
                     }
 
-                    access_unit_counter.count_nalu(&nalu)?;
+                    if config.frame_count {
+                        access_unit_counter.count_nalu(&nalu)?;
+                    }
 
-                    let mut bs = h265::Bitstream::new(nalu.iter().copied());
+                    let mut bs = h265::Bitstream::from_source(h265::RBSPSlice::new(nalu));
                     let header = h265::NALUnitHeader::decode(&mut bs)?;
 
                     match header.nal_unit_type.0 {
                         h265::NAL_UNIT_TYPE_SPS_NUT => {
-                            let bs = h265::Bitstream::new(nalu.iter().copied());
-                            let mut nalu = h265::NALUnit::decode(bs)?;
-                            *rfc6381_codec = rfc6381::codec_from_h265_nalu(nalu.clone());
-                            let mut rbsp = h265::Bitstream::new(&mut nalu.rbsp_byte);
-                            let sps = h265::SequenceParameterSet::decode(&mut rbsp)?;
-                            *width = sps.croppedWidth() as _;
-                            *height = sps.croppedHeight() as _;
-                            if sps.vui_parameters_present_flag.0 != 0
-                                && sps.vui_parameters.vui_timing_info_present_flag.0 != 0
-                                && sps.vui_parameters.vui_num_units_in_tick.0 != 0
-                            {
-                                *frame_rate =
-                                    (sps.vui_parameters.vui_time_scale.0 as f64 / sps.vui_parameters.vui_num_units_in_tick.0 as f64 * 100.0).round() / 100.0;
-                            } else {
-                                // if the frame rate is later requested we'll try to guess it via the PTS analyzer
-                                *frame_rate = 0.0;
+                            if !config.incremental || last_sps.as_slice() != nalu {
+                                let sps_nalu = h265::NALUnit::decode_slice(nalu)?;
+                                let sps = h265::SequenceParameterSet::decode(&mut sps_nalu.rbsp_byte.bitstream())?;
+                                *rfc6381_codec = Some(rfc6381::codec_from_h265_sps(&sps));
+                                *width = sps.croppedWidth() as _;
+                                *height = sps.croppedHeight() as _;
+                                *sps_frame_rate = if sps.vui_parameters_present_flag.0 != 0
+                                    && sps.vui_parameters.vui_timing_info_present_flag.0 != 0
+                                    && sps.vui_parameters.vui_num_units_in_tick.0 != 0
+                                {
+                                    (sps.vui_parameters.vui_time_scale.0 as f64 / sps.vui_parameters.vui_num_units_in_tick.0 as f64 * 100.0).round() / 100.0
+                                } else {
+                                    // if the frame rate is later requested we'll try to guess it via the PTS analyzer
+                                    0.0
+                                };
+                                if config.incremental {
+                                    last_sps.clear();
+                                    last_sps.extend_from_slice(nalu);
+                                }
+                            }
+                            // The VPS can also set the frame rate, so this is applied even if the
+                            // SPS is a repeat.
+                            if config.frame_rate {
+                                *frame_rate = *sps_frame_rate;
                             }
                         }
-                        h265::NAL_UNIT_TYPE_VPS_NUT => {
-                            let bs = h265::Bitstream::new(nalu.iter().copied());
-                            let mut nalu = h265::NALUnit::decode(bs)?;
-                            let mut rbsp = h265::Bitstream::new(&mut nalu.rbsp_byte);
-                            let vps = h265::VideoParameterSet::decode(&mut rbsp)?;
-                            if vps.vps_timing_info_present_flag.0 != 0 {
-                                *frame_rate = match vps.vps_num_units_in_tick.0 {
-                                    0 => 0.0,
-                                    num_units_in_tick => (vps.vps_time_scale.0 as f64 / num_units_in_tick as f64 * 100.0).round() / 100.0,
+                        // The VPS is only needed for its timing info.
+                        h265::NAL_UNIT_TYPE_VPS_NUT if config.frame_rate => {
+                            if !config.incremental || last_vps.as_slice() != nalu {
+                                let vps_nalu = h265::NALUnit::decode_slice(nalu)?;
+                                let vps = h265::VideoParameterSet::decode(&mut vps_nalu.rbsp_byte.bitstream())?;
+                                *vps_frame_rate = if vps.vps_timing_info_present_flag.0 != 0 {
+                                    Some(match vps.vps_num_units_in_tick.0 {
+                                        0 => 0.0,
+                                        num_units_in_tick => (vps.vps_time_scale.0 as f64 / num_units_in_tick as f64 * 100.0).round() / 100.0,
+                                    })
+                                } else {
+                                    None
                                 };
+                                if config.incremental {
+                                    last_vps.clear();
+                                    last_vps.extend_from_slice(nalu);
+                                }
+                            }
+                            if let Some(vps_frame_rate) = vps_frame_rate {
+                                *frame_rate = *vps_frame_rate;
                             }
                         }
                         _ => {}
@@ -328,19 +410,27 @@ impl Stream {
     }
 
     pub fn write(&mut self, packet: &ts::Packet) -> Result<()> {
+        // The PES stream is moved out while its completed packets are handled since they borrow
+        // its buffer. This is cheap: an empty pes::Stream doesn't allocate.
         if let Some(pes) = self.pes() {
-            for packet in pes.write(packet)? {
-                self.handle_pes_packet(packet)?;
+            let mut pes = mem::take(pes);
+            let result = pes.write_with(packet, |packet| self.handle_pes_packet(packet));
+            if let Some(slot) = self.pes() {
+                *slot = pes;
             }
+            result?;
         }
         Ok(())
     }
 
     pub fn flush(&mut self) -> Result<()> {
         if let Some(pes) = self.pes() {
-            for packet in pes.flush() {
-                self.handle_pes_packet(packet)?;
+            let mut pes = mem::take(pes);
+            let result = pes.flush_with(|packet| self.handle_pes_packet(packet));
+            if let Some(slot) = self.pes() {
+                *slot = pes;
             }
+            result?;
         }
         Ok(())
     }
@@ -366,23 +456,29 @@ pub enum StreamInfo {
     Other,
 }
 
-#[allow(clippy::large_enum_variant)]
+// There's one of these for every possible PID, so the stream is boxed to keep the unused ones
+// small. Otherwise merely creating an analyzer means initializing tens of megabytes.
 #[derive(Clone)]
 enum PidState {
     Unused,
     Pat,
     Pmt,
-    Pes { stream: Stream },
+    Pes { stream: Box<Stream> },
 }
 
 /// Analyzer processes packets in real-time, performing cheap analysis on the streams.
 pub struct Analyzer {
     pids: Vec<PidState>,
     has_video: bool,
+    config: AnalyzerConfig,
 }
 
 impl Analyzer {
     pub fn new() -> Self {
+        Self::with_config(AnalyzerConfig::default())
+    }
+
+    pub fn with_config(config: AnalyzerConfig) -> Self {
         Self {
             pids: {
                 let mut v = vec![PidState::Unused; 0x10000];
@@ -390,6 +486,7 @@ impl Analyzer {
                 v
             },
             has_video: false,
+            config,
         }
     }
 
@@ -479,6 +576,8 @@ impl Analyzer {
                                     last_timecode: None,
                                     timecode: None,
                                     pts_analyzer: PTSAnalyzer::new(),
+                                    config: self.config,
+                                    last_sps: Vec::new(),
                                 },
                                 0x24 => Stream::HEVCVideo {
                                     pes: pes::Stream::new(),
@@ -488,13 +587,18 @@ impl Analyzer {
                                     access_unit_counter: h265::AccessUnitCounter::new(),
                                     rfc6381_codec: None,
                                     pts_analyzer: PTSAnalyzer::new(),
+                                    config: self.config,
+                                    last_sps: Vec::new(),
+                                    sps_frame_rate: 0.0,
+                                    last_vps: Vec::new(),
+                                    vps_frame_rate: None,
                                 },
                                 t => Stream::Other(t),
                             };
                             if stream.is_video() {
                                 self.has_video = true;
                             }
-                            *state = PidState::Pes { stream }
+                            *state = PidState::Pes { stream: Box::new(stream) }
                         }
                     };
                 }
@@ -926,6 +1030,74 @@ mod test {
         );
     }
 
+    fn analyze_file(path: &str, config: AnalyzerConfig) -> Vec<StreamInfo> {
+        let mut analyzer = Analyzer::with_config(config);
+        let mut f = File::open(path).unwrap();
+        let mut buf = Vec::new();
+        f.read_to_end(&mut buf).unwrap();
+        let packets = ts::decode_packets(&buf).unwrap();
+        analyzer.handle_packets(&packets).unwrap();
+        analyzer.flush().unwrap();
+        analyzer.streams()
+    }
+
+    #[test]
+    fn test_analyzer_incremental() {
+        for path in &[
+            "src/testdata/h264-8k.ts",
+            "src/testdata/h265.ts",
+            "src/testdata/h265-cropped.ts",
+            "src/testdata/restart.ts",
+        ] {
+            assert_eq!(
+                analyze_file(path, AnalyzerConfig::default()),
+                analyze_file(
+                    path,
+                    AnalyzerConfig {
+                        incremental: false,
+                        ..Default::default()
+                    }
+                ),
+                "{}",
+                path
+            );
+        }
+    }
+
+    #[test]
+    fn test_analyzer_resolution_only() {
+        let config = AnalyzerConfig {
+            frame_rate: false,
+            frame_count: false,
+            timecodes: false,
+            incremental: true,
+        };
+        assert_eq!(
+            analyze_file("src/testdata/h264-8k.ts", config)[0],
+            StreamInfo::Video {
+                width: 7680,
+                height: 4320,
+                frame_rate: 0.0,
+                frame_count: 0,
+                rfc6381_codec: Some("avc1.42003c".to_string()),
+                timecode: None,
+                is_interlaced: false,
+            }
+        );
+        assert_eq!(
+            analyze_file("src/testdata/h265.ts", config)[0],
+            StreamInfo::Video {
+                width: 1280,
+                height: 720,
+                frame_rate: 0.0,
+                frame_count: 0,
+                rfc6381_codec: Some("hvc1.4.10.L120.9D.08".to_string()),
+                timecode: None,
+                is_interlaced: false,
+            }
+        );
+    }
+
     #[test]
     fn test_pts_analyzer_b_frames() {
         let mut analyzer = PTSAnalyzer::new();
@@ -5,7 +5,7 @@ use mpeg2::{
     ts::{Packet, PACKET_LENGTH},
 };
 use std::{fmt, io, time::Duration};
-use tokio::io::{AsyncRead, AsyncReadExt, AsyncWrite, AsyncWriteExt};
+use tokio::io::{AsyncRead, AsyncReadExt, AsyncWrite};
 
 struct CurrentSegment<S: AsyncWrite + Unpin> {
     segment: S,
@@ -89,83 +89,56 @@ impl<S: SegmentStorage> Segmenter<S> {
 
     /// Writes packets to the segmenter. The segmenter does not do any internal buffering, so buf
     /// must be divisible by 188 (the MPEG TS packet length).
+    ///
+    /// The packets are analyzed one at a time to find the segment boundaries, but each contiguous
+    /// run of packets belonging to a single segment is handed to the storage in one write. This
+    /// means passing larger buffers in results in fewer, larger writes.
     pub async fn write(&mut self, buf: &[u8]) -> Result<(), Error> {
         if buf.len() % PACKET_LENGTH != 0 {
             return Err(io::Error::new(io::ErrorKind::Other, "write length not divisible by packet length").into());
         }
 
-        for buf in buf.chunks(PACKET_LENGTH) {
-            let p = Packet::decode(buf)?;
+        // The offset of the first byte that belongs to the current segment, but hasn't been
+        // written to it yet.
+        let mut run_start = if self.current_segment.is_some() { Some(0) } else { None };
+        // The offset just past the last packet that was processed successfully.
+        let mut processed = 0;
+
+        let result = self.process_packets(buf, &mut run_start, &mut processed).await;
+
+        // Even if a packet fails, everything before it has already been processed, so it's written
+        // just as it would have been if the packets had been written one at a time.
+        if let (Some(segment), Some(run_start)) = (&mut self.current_segment, run_start) {
+            return result.and(Self::write_run(&mut self.storage, segment, &buf[run_start..processed]).await);
+        }
+        result
+    }
+
+    /// Processes each of the packets in buf, writing the runs that end at segment boundaries. The
+    /// run that's in progress when this returns is left for the caller to write.
+    async fn process_packets(&mut self, buf: &[u8], run_start: &mut Option<usize>, processed: &mut usize) -> Result<(), Error> {
+        for (i, packet_buf) in buf.chunks(PACKET_LENGTH).enumerate() {
+            let offset = i * PACKET_LENGTH;
+            let p = Packet::decode(packet_buf)?;
             self.analyzer.handle_packet(&p)?;
 
             if let Some(af) = &p.adaptation_field {
                 self.pcr = af.program_clock_reference_27mhz.or(self.pcr);
             }
 
-            let mut should_start_new_segment = false;
-            if self.analyzer.is_pes(p.packet_id) {
-                if let Some(pcr) = self.pcr {
-                    should_start_new_segment = match &self.current_segment {
-                        Some(current_segment) => {
-                            let elapsed_seconds = (pcr as i64 - current_segment.pcr as i64) as f64 / 27_000_000.0;
-                            if (self.analyzer.is_video(p.packet_id) || !self.analyzer.has_video())
-                                && (elapsed_seconds < -1.0 || elapsed_seconds >= self.config.min_segment_duration.as_secs_f64())
-                            {
-                                // start a new segment if this is a keyframe
-                                if p.adaptation_field.as_ref().and_then(|af| af.random_access_indicator).unwrap_or(false) {
-                                    true
-                                } else if let Some(payload) = &p.payload {
-                                    // Some muxers don't set RAI bits. If possible, see if this
-                                    // packet includes the start of a keyframe. This is only the
-                                    // first packet (<188 bytes), not the entire frame. That means
-                                    // we need to be defensive and not error out if we reach the
-                                    // end unexpectedly soon.
-                                    let mut is_keyframe = false;
-                                    match self.analyzer.stream(p.packet_id) {
-                                        Some(analyzer::Stream::AVCVideo { .. }) => {
-                                            for nalu in h264::iterate_annex_b(&payload) {
-                                                if !nalu.is_empty() {
-                                                    let nalu_type = nalu[0] & h264::NAL_UNIT_TYPE_MASK;
-                                                    is_keyframe |= nalu_type == h264::NAL_UNIT_TYPE_CODED_SLICE_OF_IDR_PICTURE;
-                                                }
-                                            }
-                                        }
-                                        Some(analyzer::Stream::HEVCVideo { .. }) => {
-                                            use h265::Decode;
-                                            for nalu in h265::iterate_annex_b(&payload) {
-                                                let mut bs = h265::Bitstream::new(nalu.iter().copied());
-                                                if let Ok(header) = h265::NALUnitHeader::decode(&mut bs) {
-                                                    if header.nuh_layer_id.0 == 0 {
-                                                        if let 16..=21 = header.nal_unit_type.0 {
-                                                            is_keyframe = true
-                                                        }
-                                                    }
-                                                }
-                                            }
-                                        }
-                                        _ => {}
-                                    }
-                                    is_keyframe
-                                } else {
-                                    false
-                                }
-                            } else {
-                                false
-                            }
-                        }
-                        None => true,
+            if self.should_start_new_segment(&p) {
+                if let Some(mut prev) = self.current_segment.take() {
+                    if let Some(run_start) = *run_start {
+                        Self::write_run(&mut self.storage, &mut prev, &buf[run_start..offset]).await?;
                     }
-                }
-            }
-
-            if should_start_new_segment {
-                if let Some(prev) = self.current_segment.take() {
-                    let info = SegmentInfo::compile(&prev, self.analyzer.streams(), &self.streams_before_segment);
+                    let streams = self.analyzer.streams();
+                    let info = SegmentInfo::compile(&prev, &streams, &self.streams_before_segment);
                     self.storage.finalize_segment(prev.segment, info).await?;
+                    self.streams_before_segment = streams;
+                } else {
+                    self.streams_before_segment = self.analyzer.streams();
                 }
 
-                self.streams_before_segment = self.analyzer.streams();
-
                 self.current_segment = Some(CurrentSegment {
                     segment: self.storage.new_segment().await?,
                     pcr: self.pcr.unwrap_or(0),
@@ -173,6 +146,7 @@ impl<S: SegmentStorage> Segmenter<S> {
                     bytes_written: 0,
                     temi_timeline_descriptor: None,
                 });
+                *run_start = Some(offset);
 
                 self.analyzer.reset_timecodes();
             }
@@ -191,18 +165,88 @@ impl<S: SegmentStorage> Segmenter<S> {
                         segment.temi_timeline_descriptor = af.temi_timeline_descriptors.into_iter().next();
                     }
                 }
-
-                segment.segment.write_all(buf).await?;
-                segment.bytes_written += buf.len();
             }
+
+            *processed = offset + PACKET_LENGTH;
         }
 
         Ok(())
     }
 
+    async fn write_run(storage: &mut S, segment: &mut CurrentSegment<S::Segment>, buf: &[u8]) -> Result<(), Error> {
+        if !buf.is_empty() {
+            storage.write_segment_data(&mut segment.segment, buf).await?;
+            segment.bytes_written += buf.len();
+        }
+        Ok(())
+    }
+
+    /// Determines whether or not the given packet, which has already been given to the analyzer,
+    /// should be the first packet of a new segment.
+    fn should_start_new_segment(&self, p: &Packet) -> bool {
+        if !self.analyzer.is_pes(p.packet_id) {
+            return false;
+        }
+        let pcr = match self.pcr {
+            Some(pcr) => pcr,
+            None => return false,
+        };
+        let current_segment = match &self.current_segment {
+            Some(current_segment) => current_segment,
+            None => return true,
+        };
+
+        let elapsed_seconds = (pcr as i64 - current_segment.pcr as i64) as f64 / 27_000_000.0;
+        let is_boundary_candidate = (self.analyzer.is_video(p.packet_id) || !self.analyzer.has_video())
+            && (elapsed_seconds < -1.0 || elapsed_seconds >= self.config.min_segment_duration.as_secs_f64());
+        if !is_boundary_candidate {
+            return false;
+        }
+
+        // start a new segment if this is a keyframe
+        if p.adaptation_field.as_ref().and_then(|af| af.random_access_indicator).unwrap_or(false) {
+            return true;
+        }
+
+        let payload = match &p.payload {
+            Some(payload) => payload,
+            None => return false,
+        };
+
+        // Some muxers don't set RAI bits. If possible, see if this packet includes the start of a
+        // keyframe. This is only the first packet (<188 bytes), not the entire frame. That means
+        // we need to be defensive and not error out if we reach the end unexpectedly soon.
+        let mut is_keyframe = false;
+        match self.analyzer.stream(p.packet_id) {
+            Some(analyzer::Stream::AVCVideo { .. }) => {
+                for nalu in h264::iterate_annex_b(payload) {
+                    if !nalu.is_empty() {
+                        let nalu_type = nalu[0] & h264::NAL_UNIT_TYPE_MASK;
+                        is_keyframe |= nalu_type == h264::NAL_UNIT_TYPE_CODED_SLICE_OF_IDR_PICTURE;
+                    }
+                }
+            }
+            Some(analyzer::Stream::HEVCVideo { .. }) => {
+                use h265::Decode;
+                for nalu in h265::iterate_annex_b(payload) {
+                    let mut bs = h265::Bitstream::new(nalu.iter().copied());
+                    if let Ok(header) = h265::NALUnitHeader::decode(&mut bs) {
+                        if header.nuh_layer_id.0 == 0 {
+                            if let 16..=21 = header.nal_unit_type.0 {
+                                is_keyframe = true
+                            }
+                        }
+                    }
+                }
+            }
+            _ => {}
+        }
+        is_keyframe
+    }
+
     pub async fn flush(&mut self) -> Result<(), Error> {
         if let Some(segment) = self.current_segment.take() {
-            let info = SegmentInfo::compile(&segment, self.analyzer.streams(), &self.streams_before_segment);
+            let info = SegmentInfo::compile(&segment, &self.analyzer.streams(), &self.streams_before_segment);
             self.storage.finalize_segment(segment.segment, info).await?;
         }
         Ok(())
@@ -236,12 +280,12 @@ pub struct SegmentInfo {
 }
 
 impl SegmentInfo {
-    fn compile<S: AsyncWrite + Unpin>(segment: &CurrentSegment<S>, streams: Vec<StreamInfo>, prev_streams: &[StreamInfo]) -> Self {
+    fn compile<S: AsyncWrite + Unpin>(segment: &CurrentSegment<S>, streams: &[StreamInfo], prev_streams: &[StreamInfo]) -> Self {
         Self {
             size: segment.bytes_written,
             presentation_time: segment.pts,
             streams: if streams.len() != prev_streams.len() {
-                streams
+                streams.to_vec()
             } else {
                 streams
                     .iter()
@@ -358,6 +402,36 @@ mod test {
         }
     }
 
+    #[tokio::test]
+    async fn test_segmenter_corrupt_packet() {
+        let mut storage = MemorySegmentStorage::new();
+
+        let mut f = File::open("src/testdata/h264-8k.ts").unwrap();
+        let mut buf = Vec::new();
+        f.read_to_end(&mut buf).unwrap();
+
+        // corrupt the sync byte of a packet in the middle of the second write
+        let chunk_size = PACKET_LENGTH * 1000;
+        let corrupt_packet = 1500;
+        buf[corrupt_packet * PACKET_LENGTH] = 0;
+
+        let mut segmenter = Segmenter::new(
+            SegmenterConfig {
+                min_segment_duration: Duration::from_secs(1),
+            },
+            &mut storage,
+        );
+        let mut chunks = buf.chunks(chunk_size);
+        segmenter.write(chunks.next().unwrap()).await.unwrap();
+        assert!(segmenter.write(chunks.next().unwrap()).await.is_err());
+        segmenter.flush().await.unwrap();
+
+        // everything up to the corrupt packet should have been written
+        let written: Vec<u8> = storage.segments().iter().flat_map(|(data, _)| data.iter().copied()).collect();
+        assert!(!written.is_empty());
+        assert!(buf[..corrupt_packet * PACKET_LENGTH].ends_with(&written));
+    }
+
     #[tokio::test]
     async fn test_segmenter_8k() {
         let mut storage = MemorySegmentStorage::new();
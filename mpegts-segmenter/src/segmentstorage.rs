@@ -9,6 +9,14 @@ pub trait SegmentStorage: Send + Unpin + Sized {
     /// Returns a Future that creates a new segment using poll_new_segment.
     async fn new_segment(&mut self) -> io::Result<Self::Segment>;
 
+    /// Writes a contiguous run of packets to the segment. The segmenter calls this once per run
+    /// rather than once per packet, so implementations that can consume the borrowed buffer
+    /// directly (e.g. by copying it into their own storage) can override this to avoid going
+    /// through AsyncWrite. By default the data is just written to the segment.
+    async fn write_segment_data(&mut self, segment: &mut Self::Segment, data: &[u8]) -> io::Result<()> {
+        segment.write_all(data).await
+    }
+
     /// Implementations can override this for a chance to do something with segments once they're
     /// completed. By default the segment is just shut down.
     async fn finalize_segment(&mut self, mut segment: Self::Segment, _info: SegmentInfo) -> io::Result<()> {
@@ -24,6 +32,10 @@ impl<T: SegmentStorage> SegmentStorage for &mut T {
         T::new_segment(self).await
     }
 
+    async fn write_segment_data(&mut self, segment: &mut Self::Segment, data: &[u8]) -> io::Result<()> {
+        T::write_segment_data(self, segment, data).await
+    }
+
     async fn finalize_segment(&mut self, segment: Self::Segment, info: SegmentInfo) -> io::Result<()> {
         T::finalize_segment(self, segment, info).await
     }
@@ -57,6 +69,11 @@ impl SegmentStorage for MemorySegmentStorage {
         Ok(Vec::new())
     }
 
+    async fn write_segment_data(&mut self, segment: &mut Self::Segment, data: &[u8]) -> io::Result<()> {
+        segment.extend_from_slice(data);
+        Ok(())
+    }
+
     async fn finalize_segment(&mut self, segment: Self::Segment, info: SegmentInfo) -> io::Result<()> {
         debug_assert!(info.size == segment.len());
         self.segments.push((segment, info));
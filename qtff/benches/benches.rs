@@ -0,0 +1,213 @@
+use byteorder::{BigEndian, ByteOrder};
+use criterion::{criterion_group, criterion_main, BatchSize, BenchmarkId, Criterion, Throughput};
+use qtff::{AtomSize, AtomWriteExt, FourCC, MediaInformationData};
+use std::{
+    io::{BufWriter, Seek, SeekFrom, Write},
+    path::Path,
+};
+
+// About an hour of 29.97 fps video.
+const SAMPLE_COUNT: u32 = 100_000;
+
+// Writes a movie with a single video track made up of SAMPLE_COUNT samples of around 2 KB each,
+// with a sync sample every 30 samples.
+fn write_movie<P: AsRef<Path>>(path: P) {
+    const SAMPLES_PER_CHUNK: u32 = 10;
+
+    let mut w = BufWriter::new(std::fs::File::create(path).unwrap());
+    let sample_sizes: Vec<u32> = (0..SAMPLE_COUNT).map(|n| 2000 + n % 100).collect();
+    let mut chunk_offsets = vec![];
+    w.write_atom_header(FourCC::MDAT, AtomSize::ExtendedSize(sample_sizes.iter().map(|&n| n as u64).sum()))
+        .unwrap();
+    let mut offset = 16;
+    for (n, &size) in sample_sizes.iter().enumerate() {
+        if n as u32 % SAMPLES_PER_CHUNK == 0 {
+            chunk_offsets.push(offset);
+        }
+        w.write_all(&vec![n as u8; size as _]).unwrap();
+        offset += size as u64;
+    }
+
+    let atom = |typ: FourCC, data: &[u8]| -> Vec<u8> {
+        let mut buf = Vec::new();
+        buf.write_atom_header(typ, data.len()).unwrap();
+        buf.extend_from_slice(data);
+        buf
+    };
+
+    let mut stsd = vec![0; 8 + 86];
+    BigEndian::write_u32(&mut stsd[4..], 1);
+    BigEndian::write_u32(&mut stsd[8..], 86);
+    BigEndian::write_u32(&mut stsd[12..], FourCC::AVC1.0);
+    BigEndian::write_u16(&mut stsd[22..], 1);
+    let mut stbl = atom(FourCC::STSD, &stsd);
+    stbl.write_atom(qtff::TimeToSampleData {
+        version: 0,
+        flags: [0; 3],
+        entries: vec![qtff::TimeToSampleDataEntry {
+            sample_count: SAMPLE_COUNT,
+            sample_duration: 1001,
+        }],
+    })
+    .unwrap();
+    stbl.write_atom(qtff::SyncSampleData {
+        version: 0,
+        flags: [0; 3],
+        sample_numbers: (1..=SAMPLE_COUNT).step_by(30).collect(),
+    })
+    .unwrap();
+    stbl.write_atom(qtff::SampleToChunkData {
+        version: 0,
+        flags: [0; 3],
+        entries: vec![qtff::SampleToChunkDataEntry {
+            first_chunk: 1,
+            samples_per_chunk: SAMPLES_PER_CHUNK,
+            sample_description_id: 1,
+        }],
+    })
+    .unwrap();
+    stbl.write_atom(qtff::SampleSizeData {
+        version: 0,
+        flags: [0; 3],
+        constant_sample_size: 0,
+        sample_count: SAMPLE_COUNT,
+        sample_sizes,
+    })
+    .unwrap();
+    stbl.write_atom(qtff::ChunkOffset64Data {
+        version: 0,
+        flags: [0; 3],
+        offsets: chunk_offsets,
+    })
+    .unwrap();
+
+    let mut hdlr = [0; 24];
+    BigEndian::write_u32(&mut hdlr[8..], FourCC::VIDE.0);
+    let mut minf = atom(FourCC::VMHD, &[0; 12]);
+    minf.extend(atom(FourCC::STBL, &stbl));
+
+    let mut mdhd = [0; 24];
+    BigEndian::write_u32(&mut mdhd[12..], 30000);
+    BigEndian::write_u32(&mut mdhd[16..], SAMPLE_COUNT * 1001);
+    let mut mdia = atom(FourCC::MDHD, &mdhd);
+    mdia.extend(atom(FourCC::HDLR, &hdlr));
+    mdia.extend(atom(FourCC::MINF, &minf));
+
+    let mut tkhd = [0; 84];
+    BigEndian::write_u32(&mut tkhd[12..], 1);
+    let mut trak = atom(FourCC::TKHD, &tkhd);
+    trak.extend(atom(FourCC::MDIA, &mdia));
+
+    let mut mvhd = [0; 100];
+    BigEndian::write_u32(&mut mvhd[12..], 30000);
+    BigEndian::write_u32(&mut mvhd[16..], SAMPLE_COUNT * 1001);
+    let mut moov = atom(FourCC::MVHD, &mvhd);
+    moov.extend(atom(FourCC::TRAK, &trak));
+    w.write_all(&atom(FourCC::MOOV, &moov)).unwrap();
+}
+
+// The benchmark movie is written once up front and never modified after that, so it's safe to
+// map.
+fn open(path: &Path, mmap: bool) -> qtff::File {
+    if mmap {
+        unsafe { qtff::File::open_mmap(path) }.unwrap()
+    } else {
+        qtff::File::open(path).unwrap()
+    }
+}
+
+fn criterion_benchmark(c: &mut Criterion) {
+    let dir = tempfile::TempDir::new().unwrap();
+    let path = dir.path().join("large.mov");
+    write_movie(&path);
+
+    {
+        let mut group = c.benchmark_group("qtff_open");
+        for &(name, mmap) in &[("read", false), ("mmap", true)] {
+            group.bench_function(BenchmarkId::new("movie_data", name), |b| {
+                b.iter(|| open(&path, mmap).movie_data().unwrap().tracks.len())
+            });
+        }
+        group.finish();
+    }
+
+    {
+        let mut group = c.benchmark_group("qtff_seek");
+        let mut f = open(&path, true);
+        let movie_data = f.get_movie_data().unwrap();
+        let stbl = match &movie_data.tracks[0].media.information {
+            Some(MediaInformationData::Video(minf)) => minf.sample_table.as_ref().unwrap(),
+            _ => panic!("expected a video track"),
+        };
+        let times: Vec<u64> = (0..100).map(|i| i * (SAMPLE_COUNT as u64 - 1) / 100 * 1001 + 500).collect();
+
+        group.bench_function("build_index", |b| {
+            b.iter_batched(
+                || {
+                    let mut f = open(&path, true);
+                    f.movie_data().unwrap();
+                    f
+                },
+                |mut f| f.sample_index(1).unwrap().len(),
+                BatchSize::LargeInput,
+            )
+        });
+
+        // Without an index, finding the sample for a time and then its offset means walking the
+        // tables from the start.
+        group.bench_function(BenchmarkId::new("100_seeks", "sample_table"), |b| {
+            let stts = stbl.time_to_sample.as_ref().unwrap();
+            b.iter(|| {
+                times
+                    .iter()
+                    .map(|&t| {
+                        let n = (0..stbl.sample_count()).take_while(|&n| stts.sample_time(n + 1).unwrap() <= t).count() as u64;
+                        stbl.sample_offset(n, &stbl.sample_chunk_info(n, None).unwrap()).unwrap()
+                    })
+                    .sum::<u64>()
+            })
+        });
+
+        let index = f.sample_index(1).unwrap();
+        group.bench_function(BenchmarkId::new("100_seeks", "sample_index"), |b| {
+            b.iter(|| times.iter().map(|&t| index.sample(index.seek(t).unwrap()).unwrap().offset).sum::<u64>())
+        });
+        group.finish();
+    }
+
+    {
+        let mut group = c.benchmark_group("qtff_trim");
+        group.sample_size(10);
+        // half of the movie, from the middle
+        let (start_frame, frame_count) = (SAMPLE_COUNT as u64 / 4, SAMPLE_COUNT as u64 / 2);
+        let out_path = dir.path().join("trimmed.mov");
+        let mut out = std::fs::OpenOptions::new().create(true).read(true).write(true).open(&out_path).unwrap();
+        let mut reset = |out: &mut std::fs::File| {
+            out.set_len(0).unwrap();
+            out.seek(SeekFrom::Start(0)).unwrap();
+        };
+        group.throughput(Throughput::Bytes(frame_count * 2050));
+
+        for &(name, mmap) in &[("read", false), ("mmap", true)] {
+            let mut f = open(&path, mmap);
+            group.bench_function(BenchmarkId::new("write", name), |b| {
+                b.iter(|| {
+                    reset(&mut out);
+                    f.trim_frames(&mut out, start_frame, frame_count).unwrap();
+                })
+            });
+        }
+
+        let mut f = open(&path, false);
+        group.bench_function(BenchmarkId::new("to_file", "copy_file_range"), |b| {
+            b.iter(|| {
+                reset(&mut out);
+                f.trim_frames_to_file(&mut out, start_frame, frame_count).unwrap();
+            })
+        });
+        group.finish();
+    }
+}
+
+criterion_group!(benches, criterion_benchmark);
+criterion_main!(benches);
@@ -1,6 +1,7 @@
 use std::{
     io,
     io::{copy, Read, Seek, SeekFrom, Write},
+    ops::Range,
 };
 
 use byteorder::{BigEndian, ByteOrder, ReadBytesExt, WriteBytesExt};
@@ -193,11 +194,17 @@ pub struct Atom {
 
 impl Atom {
     pub fn data<R: Read + Seek>(&self, reader: R) -> SectionReader<R> {
+        let range = self.data_range();
+        SectionReader::new(reader, range.start, range.len())
+    }
+
+    // Returns the range of the atom's data within the reader that it was read from.
+    pub fn data_range(&self) -> Range<usize> {
         let header_size = match self.size {
             AtomSize::Size(_) => 8,
             AtomSize::ExtendedSize(_) => 16,
         };
-        SectionReader::new(reader, self.offset + header_size, self.size.as_usize() - header_size)
+        (self.offset + header_size)..(self.offset + self.size.as_usize())
     }
 
     pub fn copy<R: Read + Seek, W: Write>(&self, mut reader: R, mut writer: W) -> io::Result<()> {
@@ -482,6 +482,25 @@ impl TimeToSampleData {
     }
 }
 
+#[derive(Clone, Debug, Default, Deserialize, PartialEq, Eq, Serialize)]
+pub struct SyncSampleData {
+    pub version: u8,
+    pub flags: [u8; 3],
+    // The one-based numbers of the sync samples, in ascending order.
+    pub sample_numbers: Vec<u32>,
+}
+
+impl AtomData for SyncSampleData {
+    const TYPE: FourCC = FourCC::STSS;
+}
+
+impl SyncSampleData {
+    // Returns whether the given zero-based sample number is a sync sample.
+    pub fn is_sync_sample(&self, n: u64) -> bool {
+        self.sample_numbers.binary_search(&((n + 1) as u32)).is_ok()
+    }
+}
+
 #[derive(Clone, Debug, Deserialize, PartialEq, Eq, Serialize)]
 pub struct SampleToChunkDataEntry {
     pub first_chunk: u32,
@@ -1212,6 +1231,8 @@ pub struct SampleTableData<M: MediaType> {
     pub sample_size: Option<SampleSizeData>,
     pub sample_to_chunk: Option<SampleToChunkData>,
     pub time_to_sample: Option<TimeToSampleData>,
+    // If absent, every sample is a sync sample.
+    pub sync_sample: Option<SyncSampleData>,
 }
 
 impl<M: MediaType> Default for SampleTableData<M> {
@@ -1223,6 +1244,7 @@ impl<M: MediaType> Default for SampleTableData<M> {
             sample_size: None,
             sample_to_chunk: None,
             time_to_sample: None,
+            sync_sample: None,
         }
     }
 }
@@ -1240,6 +1262,7 @@ impl<M: MediaType> ReadData for SampleTableData<M> {
             sample_size: read_one(&mut reader)?,
             sample_to_chunk: read_one(&mut reader)?,
             time_to_sample: read_one(&mut reader)?,
+            sync_sample: read_one(&mut reader)?,
         })
     }
 }
@@ -1746,6 +1769,7 @@ mod tests {
         let table = SampleTableData::<VideoMediaType> {
             sample_description: None,
             time_to_sample: None,
+            sync_sample: None,
             chunk_offset: Some(ChunkOffsetData {
                 version: 0,
                 flags: [0; 3],
@@ -1778,6 +1802,7 @@ mod tests {
         let table = SampleTableData::<SoundMediaType> {
             sample_description: None,
             time_to_sample: None,
+            sync_sample: None,
             chunk_offset: Some(ChunkOffsetData {
                 version: 0,
                 flags: [0; 3],
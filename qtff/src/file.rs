@@ -1,8 +1,11 @@
+use std::borrow::Cow;
+use std::collections::HashMap;
 use std::io::{copy, Cursor, Read, Seek, SeekFrom, Write};
 use std::path::Path;
 
-use super::atom::{AtomReader, AtomSize, AtomWriteExt, FourCC};
+use super::atom::{Atom, AtomReader, AtomSize, AtomWriteExt, FourCC};
 use super::error::{Error, Result};
+use super::sample_index::SampleIndex;
 use super::{
     data,
     data::{AtomData, MovieData, ReadData},
@@ -10,11 +13,14 @@ use super::{
 
 use crate::moof::MovieFragment;
 use byteorder::{BigEndian, ReadBytesExt, WriteBytesExt};
+use memmap2::Mmap;
 
 pub struct File {
     f: std::fs::File,
+    mmap: Option<Mmap>,
     movie_data: Option<MovieData>,
     movie_fragments: Option<Vec<(u64, MovieFragment)>>,
+    sample_indices: HashMap<u32, SampleIndex>,
 }
 
 enum Data {
@@ -35,75 +41,172 @@ impl File {
     pub fn open<P: AsRef<Path>>(path: P) -> Result<File> {
         Ok(File {
             f: std::fs::File::open(path)?,
+            mmap: None,
             movie_data: None,
             movie_fragments: None,
+            sample_indices: HashMap::new(),
         })
     }
 
-    fn read_moov_data(&mut self) -> Result<Vec<u8>> {
-        self.f.seek(SeekFrom::Start(0))?;
-        let atom = match AtomReader::new(&mut self.f).find(|a| match a {
+    /// Opens the file and maps it into memory. Atoms are then parsed directly from the mapping
+    /// instead of being read into intermediate buffers, and trimming copies media straight out of
+    /// it.
+    ///
+    /// # Safety
+    /// The caller must ensure that the file is not modified or truncated, by this process or any
+    /// other, while the returned `File` is alive. Otherwise the mapped bytes may change underneath
+    /// it, or accessing them may crash the process with SIGBUS.
+    pub unsafe fn open_mmap<P: AsRef<Path>>(path: P) -> Result<File> {
+        let f = std::fs::File::open(path)?;
+        let mmap = Mmap::map(&f)?;
+        Ok(File {
+            f,
+            mmap: Some(mmap),
+            movie_data: None,
+            movie_fragments: None,
+            sample_indices: HashMap::new(),
+        })
+    }
+
+    // Iterates over the top-level atoms, starting at the given offset.
+    fn atoms(&self, offset: u64) -> Result<impl '_ + Iterator<Item = std::io::Result<Atom>>> {
+        Ok(match &self.mmap {
+            Some(mmap) => {
+                let mut r = Cursor::new(&mmap[..]);
+                r.set_position(offset);
+                either::Left(AtomReader::new(r))
+            }
+            None => {
+                let mut r = &self.f;
+                r.seek(SeekFrom::Start(offset))?;
+                either::Right(AtomReader::new(r))
+            }
+        })
+    }
+
+    // Returns the data of a top-level atom. If the file is memory mapped, this borrows from the
+    // mapping.
+    fn atom_data(&self, atom: &Atom) -> Result<Cow<'_, [u8]>> {
+        self.read_source(atom.data_range().start as _, atom.data_range().len())
+    }
+
+    // Returns the given range of the file. If the file is memory mapped, this borrows from the
+    // mapping.
+    fn read_source(&self, offset: u64, size: usize) -> Result<Cow<'_, [u8]>> {
+        match &self.mmap {
+            Some(mmap) => mmap
+                .get(offset as usize..offset as usize + size)
+                .map(Cow::Borrowed)
+                .ok_or(Error::MalformedFile("unexpected end of file")),
+            None => {
+                let mut r = &self.f;
+                r.seek(SeekFrom::Start(offset))?;
+                let mut buf = Vec::new();
+                buf.resize(size, 0);
+                r.read_exact(&mut buf)?;
+                Ok(Cow::Owned(buf))
+            }
+        }
+    }
+
+    // Copies the given range of the file to the writer.
+    fn copy_source<W: Write>(&self, offset: u64, size: usize, mut w: W) -> Result<()> {
+        match &self.mmap {
+            Some(_) => w.write_all(&self.read_source(offset, size)?)?,
+            None => {
+                let mut r = &self.f;
+                r.seek(SeekFrom::Start(offset))?;
+                copy(&mut r.take(size as u64), &mut w)?;
+            }
+        }
+        Ok(())
+    }
+
+    fn find_moov(&self) -> Result<Atom> {
+        match self.atoms(0)?.find(|a| match a {
             Ok(a) => a.typ == MovieData::TYPE,
             Err(_) => true,
         }) {
-            Some(Ok(a)) => a,
-            Some(Err(err)) => return Err(err.into()),
-            None => return Err(Error::MalformedFile("missing movie")),
-        };
+            Some(Ok(a)) => Ok(a),
+            Some(Err(err)) => Err(err.into()),
+            None => Err(Error::MalformedFile("missing movie")),
+        }
+    }
+
+    fn read_moov_data(&self) -> Result<Cow<'_, [u8]>> {
         // minimize reads by pre-loading the entire atom
-        let mut buf = Vec::new();
-        atom.data(&mut self.f).read_to_end(&mut buf)?;
-        Ok(buf)
+        self.atom_data(&self.find_moov()?)
     }
 
-    pub fn get_movie_data(&mut self) -> Result<MovieData> {
-        match &self.movie_data {
-            Some(v) => Ok(v.clone()),
-            None => {
-                let buf = self.read_moov_data()?;
-                let data = MovieData::read(Cursor::new(buf.as_slice()))?;
-                self.movie_data = Some(data.clone());
-                Ok(data)
-            }
+    // Returns the movie data, which is parsed on the first call and cached after that.
+    pub fn movie_data(&mut self) -> Result<&MovieData> {
+        if self.movie_data.is_none() {
+            let buf = self.read_moov_data()?;
+            let data = MovieData::read(Cursor::new(&*buf))?;
+            self.movie_data = Some(data);
         }
+        Ok(self.movie_data.as_ref().expect("the movie data should be cached"))
+    }
+
+    pub fn get_movie_data(&mut self) -> Result<MovieData> {
+        self.movie_data().map(Clone::clone)
     }
 
-    fn get_moof_data(&mut self) -> Result<Vec<(u64, MovieFragment)>> {
+    fn get_moof_data(&self) -> Result<Vec<(u64, MovieFragment)>> {
         let mut fragments = vec![];
-        loop {
-            let start_position = self.f.stream_position()?;
-
-            let atom = match AtomReader::new(&mut self.f).find(|a| match a {
-                Ok(a) => a.typ == MovieFragment::TYPE,
-                Err(_) => true,
-            }) {
-                Some(Ok(a)) => a,
-                Some(Err(err)) => return Err(err.into()),
-                None => return Ok(fragments),
-            };
-            let mut buf = Vec::new();
-            atom.data(&mut self.f).read_to_end(&mut buf)?;
+        let mut start_position = self.find_moov()?.data_range().end as u64;
+        for atom in self.atoms(start_position)? {
+            let atom = atom?;
+            if atom.typ == MovieFragment::TYPE {
+                let buf = self.atom_data(&atom)?;
+                fragments.push((start_position, MovieFragment::read(Cursor::new(&*buf))?));
+                start_position = atom.data_range().end as u64;
+            }
+        }
+        Ok(fragments)
+    }
 
-            fragments.push((start_position, MovieFragment::read(Cursor::new(buf.as_slice()))?));
+    // Returns the movie fragments, which are parsed on the first call and cached after that.
+    pub fn movie_fragments(&mut self) -> Result<&[(u64, MovieFragment)]> {
+        if self.movie_fragments.is_none() {
+            self.movie_data()?;
+            self.movie_fragments = Some(self.get_moof_data()?);
         }
+        Ok(self.movie_fragments.as_ref().expect("the movie fragments should be cached"))
     }
 
     pub fn get_movie_fragments(&mut self) -> Result<Vec<(u64, MovieFragment)>> {
-        if self.movie_data.is_none() {
-            self.get_movie_data()?;
-        }
-        match &self.movie_fragments {
-            Some(v) => Ok(v.clone()),
-            None => {
-                let movie_fragments = self.get_moof_data()?;
-                self.movie_fragments = Some(movie_fragments.clone());
-                Ok(movie_fragments)
+        self.movie_fragments().map(<[_]>::to_vec)
+    }
+
+    // Returns the sample index for the track with the given id, which is built on the first call
+    // and cached after that.
+    pub fn sample_index(&mut self, track_id: u32) -> Result<&SampleIndex> {
+        if !self.sample_indices.contains_key(&track_id) {
+            let track = self
+                .movie_data()?
+                .tracks
+                .iter()
+                .find(|t| t.header.id == track_id)
+                .ok_or(Error::Other("track not found"))?;
+            let index = match &track.media.information {
+                Some(data::MediaInformationData::Sound(minf)) => minf.sample_table.as_ref().map(SampleIndex::new),
+                Some(data::MediaInformationData::Video(minf)) => minf.sample_table.as_ref().map(SampleIndex::new),
+                Some(data::MediaInformationData::Timecode(minf)) => minf.sample_table.as_ref().map(SampleIndex::new),
+                Some(data::MediaInformationData::Base(minf)) => minf.sample_table.as_ref().map(SampleIndex::new),
+                None => None,
             }
+            .ok_or(Error::Other("no sample table for track"))?
+            .ok_or(Error::MalformedFile("invalid sample table"))?;
+            self.sample_indices.insert(track_id, index);
         }
+        Ok(&self.sample_indices[&track_id])
     }
 
-    pub fn trim_frames<W: Write>(&mut self, w: W, start_frame: u64, frame_count: u64) -> Result<()> {
-        let movie_data = self.get_movie_data()?;
+    // Returns the video track's time scale along with the start time and duration of the given
+    // range of frames.
+    fn frame_range(&mut self, start_frame: u64, frame_count: u64) -> Result<(u32, u64, u64)> {
+        let movie_data = self.movie_data()?;
 
         let video_track = movie_data
             .tracks
@@ -129,7 +232,19 @@ impl File {
             .and_then(|stts| stts.sample_time(start_frame + frame_count))
             .ok_or(Error::Other("end frame not found"))?;
 
-        self.trim(w, time_scale, start_time, end_time - start_time)
+        Ok((time_scale, start_time, end_time - start_time))
+    }
+
+    pub fn trim_frames<W: Write>(&mut self, w: W, start_frame: u64, frame_count: u64) -> Result<()> {
+        let (time_scale, start, duration) = self.frame_range(start_frame, frame_count)?;
+        self.trim(w, time_scale, start, duration)
+    }
+
+    // Like trim_frames, but where possible, media is copied to the output by the kernel without
+    // passing through user space.
+    pub fn trim_frames_to_file(&mut self, f: &mut std::fs::File, start_frame: u64, frame_count: u64) -> Result<()> {
+        let (time_scale, start, duration) = self.frame_range(start_frame, frame_count)?;
+        self.trim_to_file(f, time_scale, start, duration)
     }
 
     fn trim_sample_table<M: Clone + data::MediaType>(
@@ -200,8 +315,64 @@ impl File {
         (dest, mdat)
     }
 
-    #[allow(clippy::cognitive_complexity)]
     pub fn trim<W: Write>(&mut self, mut w: W, time_scale: u32, start: u64, duration: u64) -> Result<()> {
+        let (moov, mdat) = self.trimmed_atoms(time_scale, start, duration)?;
+        Self::write_trimmed(&mut w, &moov, &mdat, |w, offset, size| self.copy_source(offset, size, w))
+    }
+
+    // Like trim, but where possible, media is copied to the output by the kernel without passing
+    // through user space. The output is written at the file's current position.
+    pub fn trim_to_file(&mut self, f: &mut std::fs::File, time_scale: u32, start: u64, duration: u64) -> Result<()> {
+        let (moov, mdat) = self.trimmed_atoms(time_scale, start, duration)?;
+        Self::write_trimmed(f, &moov, &mdat, |f, offset, size| {
+            #[cfg(target_os = "linux")]
+            {
+                if copy_file_range(&self.f, offset, f, size)? {
+                    return Ok(());
+                }
+            }
+            self.copy_source(offset, size, f)
+        })
+    }
+
+    fn write_trimmed<W: Write, F: FnMut(&mut W, u64, usize) -> Result<()>>(w: &mut W, moov: &[u8], mdat: &[Data], mut copy_source: F) -> Result<()> {
+        let mdat_data_size = mdat.iter().fold(0_u64, |acc, data| acc + data.len() as u64);
+        w.write_atom_header(FourCC::from_str("mdat"), AtomSize::ExtendedSize(mdat_data_size))?;
+        // chunks that are contiguous in the source are copied together
+        let mut pending: Option<(u64, usize)> = None;
+        for data in mdat {
+            match data {
+                Data::SourceFile(offset, size) => match pending.as_mut() {
+                    Some((pending_offset, pending_size)) if *pending_offset + *pending_size as u64 == *offset => *pending_size += size,
+                    _ => {
+                        if let Some((offset, size)) = pending.take() {
+                            copy_source(w, offset, size)?;
+                        }
+                        pending = Some((*offset, *size));
+                    }
+                },
+                Data::Vec(buf) => {
+                    if let Some((offset, size)) = pending.take() {
+                        copy_source(w, offset, size)?;
+                    }
+                    w.write_all(buf)?
+                }
+            }
+        }
+        if let Some((offset, size)) = pending {
+            copy_source(w, offset, size)?;
+        }
+
+        w.write_atom_header(MovieData::TYPE, moov.len())?;
+        w.write_all(moov)?;
+
+        Ok(())
+    }
+
+    // Builds the moov atom for the trimmed movie along with a list of the data that goes into its
+    // mdat atom.
+    #[allow(clippy::cognitive_complexity)]
+    fn trimmed_atoms(&self, time_scale: u32, start: u64, duration: u64) -> Result<(Vec<u8>, Vec<Data>)> {
         let mut moov: Vec<u8> = Vec::new();
         let mut mdat: Vec<Data> = Vec::new();
 
@@ -210,7 +381,7 @@ impl File {
         let end_time_secs = ((start + duration) as f64) / (time_scale as f64);
 
         let moov_data = self.read_moov_data()?;
-        let mut r = Cursor::new(moov_data.as_slice());
+        let mut r = Cursor::new(&*moov_data);
         for atom in AtomReader::new(&mut r).collect::<Vec<_>>().drain(..) {
             let atom = atom?;
             match atom.typ {
@@ -326,13 +497,7 @@ impl File {
                                         }
 
                                         let mut data = match &mdat[0] {
-                                            Data::SourceFile(source_offset, source_size) => {
-                                                self.f.seek(SeekFrom::Start(*source_offset))?;
-                                                let mut buf = Vec::new();
-                                                buf.resize(*source_size as usize, 0);
-                                                self.f.read_exact(&mut buf)?;
-                                                buf
-                                            }
+                                            Data::SourceFile(source_offset, source_size) => self.read_source(*source_offset, *source_size)?.into_owned(),
                                             Data::Vec(buf) => buf.clone(),
                                         };
 
@@ -473,25 +638,41 @@ impl File {
             }
         }
 
-        let mdat_data_size = mdat.iter().fold(0_u64, |acc, data| acc + data.len() as u64);
-        w.write_atom_header(FourCC::from_str("mdat"), AtomSize::ExtendedSize(mdat_data_size))?;
-        for mut data in mdat.drain(..) {
-            match &mut data {
-                Data::SourceFile(offset, size) => {
-                    self.f.seek(SeekFrom::Start(*offset))?;
-                    copy(&mut (&self.f).take(*size as u64), &mut w)?;
-                }
-                Data::Vec(buf) => {
-                    copy(&mut buf.as_slice(), &mut w)?;
+        Ok((moov, mdat))
+    }
+}
+
+// Copies the given range of the source file to the destination file's current position using
+// copy_file_range, which lets the kernel skip the copy through user space and, on filesystems that
+// support it, share the underlying extents. Returns false without copying anything if the files
+// don't support it.
+#[cfg(target_os = "linux")]
+fn copy_file_range(source: &std::fs::File, offset: u64, dest: &mut std::fs::File, size: usize) -> Result<bool> {
+    use std::os::unix::io::AsRawFd;
+
+    let dest_start = dest.stream_position()?;
+    let mut source_offset = offset as libc::loff_t;
+    let mut dest_offset = dest_start as libc::loff_t;
+    let mut remaining = size;
+    while remaining > 0 {
+        let n = unsafe { libc::copy_file_range(source.as_raw_fd(), &mut source_offset, dest.as_raw_fd(), &mut dest_offset, remaining, 0) };
+        if n < 0 {
+            let err = std::io::Error::last_os_error();
+            match err.raw_os_error() {
+                Some(libc::EINTR) => continue,
+                Some(libc::ENOSYS) | Some(libc::EXDEV) | Some(libc::EINVAL) | Some(libc::EOPNOTSUPP) | Some(libc::EBADF) if remaining == size => {
+                    return Ok(false)
                 }
+                _ => return Err(err.into()),
             }
+        } else if n == 0 {
+            return Err(Error::MalformedFile("unexpected end of file"));
         }
-
-        w.write_atom_header(MovieData::TYPE, moov.len())?;
-        copy(&mut moov.as_slice(), &mut w)?;
-
-        Ok(())
+        remaining -= n as usize;
     }
+    // copy_file_range doesn't advance the file position when given explicit offsets
+    dest.seek(SeekFrom::Start(dest_offset as u64))?;
+    Ok(true)
 }
 
 impl Read for File {
@@ -522,6 +703,158 @@ impl<'a> Seek for &'a File {
 mod tests {
     use super::*;
     use crate::moof::{FragmentHeader, TrackFragmentHeader, TrackFragmentRunSampleData};
+    use byteorder::ByteOrder;
+
+    // Writes a movie with a single video track. Each sample is filled with the low byte of its
+    // sample number, and every 30th sample is a sync sample.
+    fn write_movie<W: Write>(mut w: W, sample_count: u32) -> Result<()> {
+        const SAMPLES_PER_CHUNK: u32 = 10;
+
+        let sample_sizes: Vec<u32> = (0..sample_count).map(|n| 1000 + n % 100).collect();
+        let mut chunk_offsets = vec![];
+        w.write_atom_header(FourCC::MDAT, AtomSize::ExtendedSize(sample_sizes.iter().map(|&n| n as u64).sum()))?;
+        let mut offset = 16;
+        for (n, &size) in sample_sizes.iter().enumerate() {
+            if n as u32 % SAMPLES_PER_CHUNK == 0 {
+                chunk_offsets.push(offset);
+            }
+            w.write_all(&vec![n as u8; size as _])?;
+            offset += size as u64;
+        }
+
+        let atom = |typ: FourCC, data: &[u8]| -> Result<Vec<u8>> {
+            let mut buf = Vec::new();
+            buf.write_atom_header(typ, data.len())?;
+            buf.write_all(data)?;
+            Ok(buf)
+        };
+
+        let mut stsd = vec![0; 8 + 86];
+        BigEndian::write_u32(&mut stsd[4..], 1);
+        BigEndian::write_u32(&mut stsd[8..], 86);
+        BigEndian::write_u32(&mut stsd[12..], FourCC::AVC1.0);
+        BigEndian::write_u16(&mut stsd[22..], 1);
+        let mut stbl = atom(FourCC::STSD, &stsd)?;
+        stbl.write_atom(data::TimeToSampleData {
+            version: 0,
+            flags: [0; 3],
+            entries: vec![data::TimeToSampleDataEntry {
+                sample_count,
+                sample_duration: 1001,
+            }],
+        })?;
+        stbl.write_atom(data::SyncSampleData {
+            version: 0,
+            flags: [0; 3],
+            sample_numbers: (1..=sample_count).step_by(30).collect(),
+        })?;
+        stbl.write_atom(data::SampleToChunkData {
+            version: 0,
+            flags: [0; 3],
+            entries: vec![data::SampleToChunkDataEntry {
+                first_chunk: 1,
+                samples_per_chunk: SAMPLES_PER_CHUNK,
+                sample_description_id: 1,
+            }],
+        })?;
+        stbl.write_atom(data::SampleSizeData {
+            version: 0,
+            flags: [0; 3],
+            constant_sample_size: 0,
+            sample_count,
+            sample_sizes,
+        })?;
+        stbl.write_atom(data::ChunkOffset64Data {
+            version: 0,
+            flags: [0; 3],
+            offsets: chunk_offsets,
+        })?;
+
+        let mut hdlr = [0; 24];
+        BigEndian::write_u32(&mut hdlr[8..], FourCC::VIDE.0);
+        let mut minf = atom(FourCC::VMHD, &[0; 12])?;
+        minf.extend(atom(FourCC::STBL, &stbl)?);
+
+        let mut mdhd = [0; 24];
+        BigEndian::write_u32(&mut mdhd[12..], 30000);
+        BigEndian::write_u32(&mut mdhd[16..], sample_count * 1001);
+        let mut mdia = atom(FourCC::MDHD, &mdhd)?;
+        mdia.extend(atom(FourCC::HDLR, &hdlr)?);
+        mdia.extend(atom(FourCC::MINF, &minf)?);
+
+        let mut tkhd = [0; 84];
+        BigEndian::write_u32(&mut tkhd[12..], 1);
+        let mut trak = atom(FourCC::TKHD, &tkhd)?;
+        trak.extend(atom(FourCC::MDIA, &mdia)?);
+
+        let mut mvhd = [0; 100];
+        BigEndian::write_u32(&mut mvhd[12..], 30000);
+        BigEndian::write_u32(&mut mvhd[16..], sample_count * 1001);
+        let mut moov = atom(FourCC::MVHD, &mvhd)?;
+        moov.extend(atom(FourCC::TRAK, &trak)?);
+        w.write_all(&atom(FourCC::MOOV, &moov)?)?;
+        Ok(())
+    }
+
+    #[test]
+    fn test_file_mmap() {
+        let dir = tempfile::TempDir::new().unwrap();
+        let path = dir.path().join("tmp.mov");
+        write_movie(std::fs::File::create(&path).unwrap(), 1000).unwrap();
+
+        let mut f = File::open(&path).unwrap();
+        // nothing else touches the files in the temporary directory while they're open
+        let mut mmap_f = unsafe { File::open_mmap(&path) }.unwrap();
+        assert_eq!(f.movie_data().unwrap(), mmap_f.movie_data().unwrap());
+        assert_eq!(f.sample_index(1).unwrap(), mmap_f.sample_index(1).unwrap());
+
+        let movie_data = f.get_movie_data().unwrap();
+        let stbl = match &movie_data.tracks[0].media.information {
+            Some(data::MediaInformationData::Video(minf)) => minf.sample_table.as_ref().unwrap(),
+            _ => panic!("expected a video track"),
+        };
+        let index = f.sample_index(1).unwrap();
+        assert_eq!(index.len(), 1000);
+        for (n, sample) in index.samples().iter().enumerate() {
+            let chunk_info = stbl.sample_chunk_info(n as _, None).unwrap();
+            assert_eq!(Some(sample.offset), stbl.sample_offset(n as _, &chunk_info));
+            assert_eq!(Some(sample.size), stbl.sample_size(n as _, &chunk_info));
+            assert_eq!(Some(sample.decode_time), stbl.time_to_sample.as_ref().unwrap().sample_time(n as _));
+            assert_eq!(n % 30 == 0, sample.is_sync);
+        }
+        assert_eq!(Some(90), index.seek(100 * 1001 + 500));
+        assert!(f.sample_index(2).is_err());
+
+        // every way of trimming should produce the same file
+        let trim = |f: &mut File, to_file: bool| -> Vec<u8> {
+            let path = dir.path().join("trimmed.mov");
+            let mut f_out = std::fs::File::create(&path).unwrap();
+            // make sure the output goes where the file position is
+            f_out.write_all(b"foo").unwrap();
+            if to_file {
+                f.trim_frames_to_file(&mut f_out, 25, 500).unwrap();
+            } else {
+                f.trim_frames(&mut f_out, 25, 500).unwrap();
+            }
+            f_out.write_all(b"bar").unwrap();
+            std::fs::read(&path).unwrap()
+        };
+        let expected = trim(&mut f, false);
+        assert_eq!(expected, trim(&mut f, true));
+        assert_eq!(expected, trim(&mut mmap_f, false));
+        assert_eq!(expected, trim(&mut mmap_f, true));
+
+        let path = dir.path().join("trimmed.mov");
+        std::fs::write(&path, &expected[3..expected.len() - 3]).unwrap();
+        let mut f = unsafe { File::open_mmap(&path) }.unwrap();
+        let index = f.sample_index(1).unwrap().clone();
+        assert_eq!(index.len(), 500);
+        for (n, sample) in index.samples().iter().enumerate() {
+            assert_eq!(sample.size, 1000 + (n as u32 + 25) % 100);
+            let data = f.read_source(sample.offset, sample.size as _).unwrap();
+            assert!(data.iter().all(|&b| b == (n + 25) as u8));
+        }
+    }
 
     #[test]
     fn test_file_prores() {
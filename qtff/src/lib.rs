@@ -9,9 +9,11 @@ pub mod deserializer;
 pub mod error;
 pub mod file;
 pub mod moof;
+pub mod sample_index;
 pub mod serializer;
 
 pub use atom::*;
 pub use data::*;
 pub use error::*;
 pub use file::*;
+pub use sample_index::*;
@@ -0,0 +1,249 @@
+use super::data::{MediaType, SampleTableData};
+
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+pub struct Sample {
+    // The offset within the file of the sample's data.
+    pub offset: u64,
+    pub size: u32,
+    // The decode time in the media's time scale.
+    pub decode_time: u64,
+    pub is_sync: bool,
+}
+
+// A flattened copy of a track's sample table. Locating a sample via the sample table means walking
+// the sample-to-chunk, sample size, and time-to-sample entries, which is linear in the sample
+// number. The index pays that cost once so that lookups and seeks are constant time or a binary
+// search.
+#[derive(Clone, Debug, Default, PartialEq, Eq)]
+pub struct SampleIndex {
+    samples: Vec<Sample>,
+    // The zero-based numbers of the sync samples, in ascending order.
+    sync_samples: Vec<u64>,
+}
+
+impl SampleIndex {
+    // Builds the index for the given sample table. Returns None if the table is incomplete or
+    // inconsistent.
+    pub fn new<M: MediaType>(table: &SampleTableData<M>) -> Option<Self> {
+        let sample_count = table.sample_count();
+        let chunk_offsets: Vec<u64> = table.iter_chunk_offsets()?.collect();
+        let sample_size = table.sample_size.as_ref()?;
+
+        let mut durations = table
+            .time_to_sample
+            .iter()
+            .flat_map(|stts| stts.entries.iter())
+            .flat_map(|e| std::iter::repeat(e.sample_duration as u64).take(e.sample_count as usize));
+        let mut sync_sample_numbers = table.sync_sample.as_ref().map(|stss| stss.sample_numbers.iter().peekable());
+
+        let mut ret = Self {
+            samples: Vec::with_capacity(sample_count as usize),
+            sync_samples: Vec::new(),
+        };
+        let mut decode_time = 0;
+        let mut chunk_info = None;
+        let mut n = 0;
+        while n < sample_count {
+            let info = table.sample_chunk_info(n, chunk_info.as_ref())?;
+            let mut offset = *chunk_offsets.get(info.number as usize)?;
+            let constant_sample_size =
+                M::constant_sample_size(table.sample_description(info.sample_description)?).or(if sample_size.constant_sample_size > 0 {
+                    Some(sample_size.constant_sample_size)
+                } else {
+                    None
+                });
+
+            let chunk_end = (info.first_sample + info.samples).min(sample_count);
+            if chunk_end <= n {
+                return None;
+            }
+            for n in n..chunk_end {
+                let size = match constant_sample_size {
+                    Some(size) => size,
+                    None => *sample_size.sample_sizes.get(n as usize)?,
+                };
+                let is_sync = match sync_sample_numbers.as_mut() {
+                    Some(numbers) => {
+                        while numbers.next_if(|&&number| (number as u64) < n + 1).is_some() {}
+                        numbers.next_if_eq(&&((n + 1) as u32)).is_some()
+                    }
+                    None => true,
+                };
+                if is_sync {
+                    ret.sync_samples.push(n);
+                }
+                ret.samples.push(Sample {
+                    offset,
+                    size,
+                    decode_time,
+                    is_sync,
+                });
+                offset += size as u64;
+                decode_time += durations.next().unwrap_or(0);
+            }
+
+            n = chunk_end;
+            chunk_info = Some(info);
+        }
+        Some(ret)
+    }
+
+    pub fn len(&self) -> usize {
+        self.samples.len()
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.samples.is_empty()
+    }
+
+    pub fn samples(&self) -> &[Sample] {
+        &self.samples
+    }
+
+    // Returns the given zero-based sample.
+    pub fn sample(&self, n: u64) -> Option<&Sample> {
+        self.samples.get(n as usize)
+    }
+
+    // Returns the zero-based number of the sample being decoded at the given time, which is the
+    // last sample with a decode time at or before it.
+    pub fn sample_at_time(&self, time: u64) -> Option<u64> {
+        let n = self.samples.partition_point(|s| s.decode_time <= time);
+        n.checked_sub(1).map(|n| n as u64)
+    }
+
+    // Returns the zero-based number of the last sync sample at or before the given sample.
+    pub fn sync_sample_at_or_before(&self, n: u64) -> Option<u64> {
+        let i = self.sync_samples.partition_point(|&s| s <= n);
+        i.checked_sub(1).map(|i| self.sync_samples[i])
+    }
+
+    // Returns the zero-based number of the sync sample that decoding must begin at in order to
+    // present the given time.
+    pub fn seek(&self, time: u64) -> Option<u64> {
+        self.sync_sample_at_or_before(self.sample_at_time(time)?)
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::data::*;
+
+    #[test]
+    fn test_sample_index() {
+        let mut table = SampleTableData::<GeneralMediaType> {
+            sample_description: Some(SampleDescriptionData {
+                entries: vec![GeneralSampleDescriptionDataEntry {
+                    data_format: 0,
+                    reserved: [0; 6],
+                    data_reference_index: 1,
+                }],
+            }),
+            time_to_sample: Some(TimeToSampleData {
+                version: 0,
+                flags: [0; 3],
+                entries: vec![
+                    TimeToSampleDataEntry {
+                        sample_count: 3,
+                        sample_duration: 100,
+                    },
+                    TimeToSampleDataEntry {
+                        sample_count: 2,
+                        sample_duration: 50,
+                    },
+                ],
+            }),
+            sync_sample: Some(SyncSampleData {
+                version: 0,
+                flags: [0; 3],
+                sample_numbers: vec![1, 4],
+            }),
+            chunk_offset: Some(ChunkOffsetData {
+                version: 0,
+                flags: [0; 3],
+                offsets: vec![1000, 2000, 3000],
+            }),
+            chunk_offset_64: None,
+            sample_size: Some(SampleSizeData {
+                version: 0,
+                flags: [0; 3],
+                constant_sample_size: 0,
+                sample_count: 5,
+                sample_sizes: vec![10, 20, 30, 40, 50],
+            }),
+            sample_to_chunk: Some(SampleToChunkData {
+                version: 0,
+                flags: [0; 3],
+                entries: vec![
+                    SampleToChunkDataEntry {
+                        first_chunk: 1,
+                        samples_per_chunk: 2,
+                        sample_description_id: 1,
+                    },
+                    SampleToChunkDataEntry {
+                        first_chunk: 3,
+                        samples_per_chunk: 1,
+                        sample_description_id: 1,
+                    },
+                ],
+            }),
+        };
+        let index = SampleIndex::new(&table).unwrap();
+        assert_eq!(
+            index.samples(),
+            &[
+                Sample {
+                    offset: 1000,
+                    size: 10,
+                    decode_time: 0,
+                    is_sync: true,
+                },
+                Sample {
+                    offset: 1010,
+                    size: 20,
+                    decode_time: 100,
+                    is_sync: false,
+                },
+                Sample {
+                    offset: 2000,
+                    size: 30,
+                    decode_time: 200,
+                    is_sync: false,
+                },
+                Sample {
+                    offset: 2030,
+                    size: 40,
+                    decode_time: 300,
+                    is_sync: true,
+                },
+                Sample {
+                    offset: 3000,
+                    size: 50,
+                    decode_time: 350,
+                    is_sync: false,
+                },
+            ]
+        );
+
+        for (time, sample, sync_sample) in [(0, 0, 0), (99, 0, 0), (100, 1, 0), (299, 2, 0), (300, 3, 3), (10_000, 4, 3)] {
+            assert_eq!(index.sample_at_time(time), Some(sample), "{}", time);
+            assert_eq!(index.seek(time), Some(sync_sample), "{}", time);
+        }
+
+        for (i, sample) in index.samples().iter().enumerate() {
+            let chunk_info = table.sample_chunk_info(i as _, None).unwrap();
+            assert_eq!(table.sample_offset(i as _, &chunk_info), Some(sample.offset));
+            assert_eq!(table.sample_size(i as _, &chunk_info), Some(sample.size));
+            assert_eq!(table.time_to_sample.as_ref().unwrap().sample_time(i as _), Some(sample.decode_time));
+        }
+
+        table.sync_sample = None;
+        let index = SampleIndex::new(&table).unwrap();
+        assert!(index.samples().iter().all(|s| s.is_sync));
+        assert_eq!(index.seek(299), Some(2));
+
+        table.sample_size = None;
+        assert_eq!(None, SampleIndex::new(&table));
+    }
+}
@@ -12,45 +12,68 @@ pub fn codec_from_h264_nalu<T: Iterator<Item = u8>>(mut nalu: h264::NALUnit<T>)
     None
 }
 
+/// Returns the same codec as `codec_from_h264_nalu`, but from an SPS that has already been
+/// decoded.
+pub fn codec_from_h264_sps(sps: &h264::SequenceParameterSet) -> String {
+    format!(
+        "avc1.{:02x}{:02x}{:02x}",
+        sps.profile_idc.0,
+        sps.constraint_set0_flag.0 << 7
+            | sps.constraint_set1_flag.0 << 6
+            | sps.constraint_set2_flag.0 << 5
+            | sps.constraint_set3_flag.0 << 4
+            | sps.constraint_set4_flag.0 << 3
+            | sps.constraint_set5_flag.0 << 2
+            | sps.reserved_zero_2bits.0,
+        sps.level_idc.0,
+    )
+}
+
 pub fn codec_from_h265_nalu<T: Iterator<Item = u8>>(mut nalu: h265::NALUnit<h265::RBSP<T>>) -> Option<String> {
     use h265::Decode;
     if nalu.nal_unit_header.nal_unit_type.0 == h265::NAL_UNIT_TYPE_SPS_NUT {
         let mut rbsp = h265::Bitstream::new(&mut nalu.rbsp_byte);
         let sps = h265::SequenceParameterSet::decode(&mut rbsp).ok()?;
-        let ptl = &sps.profile_tier_level;
-        return Some(format!(
-            "hvc1.{}{}.{:X}.{}{}.{}",
-            if ptl.general_profile_space.0 > 0 {
-                ((b'A' + (ptl.general_profile_space.0 - 1)) as char).to_string()
-            } else {
-                "".to_string()
-            },
-            ptl.general_profile_idc.0,
-            ptl.general_profile_compatibility_flags.0.reverse_bits(),
-            match ptl.general_tier_flag.0 {
-                0 => 'L',
-                _ => 'H',
-            },
-            ptl.general_level_idc.0,
-            {
-                let mut constraint_bytes = vec![
-                    (ptl.general_constraint_flags.0 >> 40) as u8,
-                    (ptl.general_constraint_flags.0 >> 32) as u8,
-                    (ptl.general_constraint_flags.0 >> 24) as u8,
-                    (ptl.general_constraint_flags.0 >> 16) as u8,
-                    (ptl.general_constraint_flags.0 >> 8) as u8,
-                    ptl.general_constraint_flags.0 as u8,
-                ];
-                while constraint_bytes.len() > 1 && constraint_bytes.last().copied() == Some(0) {
-                    constraint_bytes.pop();
-                }
-                constraint_bytes.into_iter().map(|b| format!("{:02X}", b)).collect::<Vec<_>>().join(".")
-            },
-        ));
+        return Some(codec_from_h265_sps(&sps));
     }
     None
 }
 
+/// Returns the same codec as `codec_from_h265_nalu`, but from an SPS that has already been
+/// decoded.
+pub fn codec_from_h265_sps(sps: &h265::SequenceParameterSet) -> String {
+    let ptl = &sps.profile_tier_level;
+    format!(
+        "hvc1.{}{}.{:X}.{}{}.{}",
+        if ptl.general_profile_space.0 > 0 {
+            ((b'A' + (ptl.general_profile_space.0 - 1)) as char).to_string()
+        } else {
+            "".to_string()
+        },
+        ptl.general_profile_idc.0,
+        ptl.general_profile_compatibility_flags.0.reverse_bits(),
+        match ptl.general_tier_flag.0 {
+            0 => 'L',
+            _ => 'H',
+        },
+        ptl.general_level_idc.0,
+        {
+            let mut constraint_bytes = vec![
+                (ptl.general_constraint_flags.0 >> 40) as u8,
+                (ptl.general_constraint_flags.0 >> 32) as u8,
+                (ptl.general_constraint_flags.0 >> 24) as u8,
+                (ptl.general_constraint_flags.0 >> 16) as u8,
+                (ptl.general_constraint_flags.0 >> 8) as u8,
+                ptl.general_constraint_flags.0 as u8,
+            ];
+            while constraint_bytes.len() > 1 && constraint_bytes.last().copied() == Some(0) {
+                constraint_bytes.pop();
+            }
+            constraint_bytes.into_iter().map(|b| format!("{:02X}", b)).collect::<Vec<_>>().join(".")
+        },
+    )
+}
+
 #[cfg(feature = "ffmpeg")]
 pub fn codec_from_ffmpeg_codec_context(codec: &ffmpeg::sys::AVCodecContext) -> Option<String> {
     use ffmpeg::sys::AVCodecID;
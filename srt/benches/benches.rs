@@ -0,0 +1,187 @@
+use criterion::{criterion_group, criterion_main, BenchmarkId, Criterion, Throughput};
+#[cfg(feature = "batched-io")]
+use srt::MaxBandwidth;
+use srt::{AsyncListener, AsyncStream, ConnectOptions, ListenerOption};
+use std::mem;
+#[cfg(feature = "batched-io")]
+use std::time::Duration;
+use tokio::{
+    io::{AsyncReadExt, AsyncWriteExt},
+    join,
+    runtime::Runtime,
+};
+
+const CONNECTIONS: usize = 1000;
+const PAYLOAD_SIZE: usize = 1316;
+#[cfg(feature = "batched-io")]
+const STREAM_PACKETS: usize = 1000;
+
+type Pair = (AsyncStream, AsyncStream);
+
+async fn connect_pairs(addr: &str, n: usize) -> (AsyncListener<'static>, Vec<Pair>) {
+    // disable timestamp-based delivery so that payloads are handed over as soon as they arrive
+    let listener = AsyncListener::bind_with_options(addr, [ListenerOption::TimestampBasedPacketDeliveryMode(false)].iter().cloned()).unwrap();
+    let options = ConnectOptions {
+        timestamp_based_packet_delivery_mode: Some(false),
+        ..Default::default()
+    };
+    let mut pairs = Vec::with_capacity(n);
+    for _ in 0..n {
+        let (accept_result, connect_result) = join!(listener.accept(), AsyncStream::connect(addr, &options));
+        pairs.push((connect_result.unwrap(), accept_result.unwrap().0));
+    }
+    (listener, pairs)
+}
+
+async fn send(client: &mut AsyncStream, server: &mut AsyncStream) {
+    let mut buf = [0; PAYLOAD_SIZE];
+    client.write_all(&[1; PAYLOAD_SIZE]).await.unwrap();
+    server.read_exact(&mut buf).await.unwrap();
+}
+
+/// Sends a payload over every connection at once, with each one received by its own task.
+async fn send_all(pairs: Vec<Pair>) -> Vec<Pair> {
+    let tasks: Vec<_> = pairs
+        .into_iter()
+        .map(|(mut client, mut server)| {
+            tokio::spawn(async move {
+                send(&mut client, &mut server).await;
+                (client, server)
+            })
+        })
+        .collect();
+    let mut pairs = Vec::with_capacity(tasks.len());
+    for task in tasks {
+        pairs.push(task.await.unwrap());
+    }
+    pairs
+}
+
+fn criterion_benchmark(c: &mut Criterion) {
+    let rt = Runtime::new().unwrap();
+
+    let mut group = c.benchmark_group("srt_epoll_reactor");
+    for &threads in &[1, 2, 4, 8] {
+        // The reactor is only torn down once every async socket is gone, so each thread count
+        // gets a fresh set of connections.
+        srt::set_epoll_reactor_threads(threads);
+        let (listener, mut pairs) = rt.block_on(connect_pairs(&format!("127.0.0.1:{}", 1500 + threads), CONNECTIONS));
+
+        group.throughput(Throughput::Bytes((CONNECTIONS * PAYLOAD_SIZE) as u64));
+        group.bench_with_input(BenchmarkId::new("throughput", threads), &threads, |b, _| {
+            b.iter(|| pairs = rt.block_on(send_all(mem::take(&mut pairs))))
+        });
+
+        // Measure how long it takes for a single payload to get through while every other
+        // connection has a read parked on the reactor.
+        let (mut client, mut server) = pairs.remove(0);
+        let parked: Vec<_> = pairs
+            .into_iter()
+            .map(|(client, mut server)| {
+                let task = rt.spawn(async move {
+                    let mut buf = [0; PAYLOAD_SIZE];
+                    server.read_exact(&mut buf).await.unwrap();
+                    server
+                });
+                (client, task)
+            })
+            .collect();
+
+        group.throughput(Throughput::Bytes(PAYLOAD_SIZE as u64));
+        group.bench_with_input(BenchmarkId::new("wakeup_latency", threads), &threads, |b, _| {
+            b.iter(|| rt.block_on(send(&mut client, &mut server)))
+        });
+
+        rt.block_on(async {
+            for (mut client, task) in parked {
+                client.write_all(&[1; PAYLOAD_SIZE]).await.unwrap();
+                mem::drop((client, task.await.unwrap()));
+            }
+        });
+        mem::drop((client, server, listener));
+    }
+    group.finish();
+}
+
+#[cfg(feature = "batched-io")]
+async fn connect_batched_io_pair(addr: &str, batched_io: bool) -> (AsyncListener<'static>, Pair) {
+    let listener = AsyncListener::bind_with_options(
+        addr,
+        [
+            ListenerOption::TimestampBasedPacketDeliveryMode(false),
+            ListenerOption::TooLatePacketDrop(false),
+            ListenerOption::BatchedIo(batched_io),
+        ]
+        .iter()
+        .cloned(),
+    )
+    .unwrap();
+    let options = ConnectOptions {
+        timestamp_based_packet_delivery_mode: Some(false),
+        too_late_packet_drop: Some(false),
+        max_bandwidth: Some(MaxBandwidth::Infinite),
+        batched_io: Some(batched_io),
+        ..Default::default()
+    };
+    let (accept_result, connect_result) = join!(listener.accept(), AsyncStream::connect(addr, &options));
+    (listener, (connect_result.unwrap(), accept_result.unwrap().0))
+}
+
+/// Sends a burst of packets over a single connection, receiving them as they arrive.
+#[cfg(feature = "batched-io")]
+async fn send_stream((client, server): &mut Pair) {
+    let write = async {
+        for _ in 0..STREAM_PACKETS {
+            client.write_all(&[1; PAYLOAD_SIZE]).await.unwrap();
+        }
+    };
+    let read = async {
+        let mut buf = [0; PAYLOAD_SIZE];
+        for _ in 0..STREAM_PACKETS {
+            server.read_exact(&mut buf).await.unwrap();
+        }
+    };
+    join!(write, read);
+}
+
+/// The CPU time used by the whole process so far, which includes SRT's own threads.
+#[cfg(feature = "batched-io")]
+fn cpu_time() -> Duration {
+    let mut usage: libc::rusage = unsafe { mem::zeroed() };
+    unsafe { libc::getrusage(libc::RUSAGE_SELF, &mut usage) };
+    let to_duration = |tv: libc::timeval| Duration::new(tv.tv_sec as u64, tv.tv_usec as u32 * 1000);
+    to_duration(usage.ru_utime) + to_duration(usage.ru_stime)
+}
+
+#[cfg(feature = "batched-io")]
+fn batched_io_benchmark(c: &mut Criterion) {
+    let rt = Runtime::new().unwrap();
+
+    let mut group = c.benchmark_group("srt_batched_io");
+    group.throughput(Throughput::Bytes((STREAM_PACKETS * PAYLOAD_SIZE) as u64));
+    for (i, &(name, batched_io)) in [("per_packet", false), ("batched", true)].iter().enumerate() {
+        let (listener, mut pair) = rt.block_on(connect_batched_io_pair(&format!("127.0.0.1:{}", 1600 + i), batched_io));
+
+        group.bench_function(BenchmarkId::new("throughput", name), |b| b.iter(|| rt.block_on(send_stream(&mut pair))));
+
+        // The same transfer, but timed by the CPU it costs rather than how long it takes.
+        group.bench_function(BenchmarkId::new("cpu_time", name), |b| {
+            b.iter_custom(|iters| {
+                let start = cpu_time();
+                for _ in 0..iters {
+                    rt.block_on(send_stream(&mut pair));
+                }
+                cpu_time() - start
+            })
+        });
+
+        mem::drop((pair, listener));
+    }
+    group.finish();
+}
+
+#[cfg(feature = "batched-io")]
+criterion_group!(benches, criterion_benchmark, batched_io_benchmark);
+#[cfg(not(feature = "batched-io"))]
+criterion_group!(benches, criterion_benchmark);
+criterion_main!(benches);
@@ -3,13 +3,34 @@ use libc::c_int as int;
 use std::{
     collections::{HashMap, HashSet},
     io::Write,
-    net,
+    mem, net,
     os::unix::{io::IntoRawFd, net::UnixStream},
-    sync::{Arc, Mutex},
+    sync::{
+        atomic::{AtomicUsize, Ordering},
+        Arc, Mutex,
+    },
     task::Waker,
     thread,
 };
 
+/// The number of epoll threads that reactors will be created with.
+static THREADS: AtomicUsize = AtomicUsize::new(1);
+
+/// The number of events each epoll thread can receive per wait when it starts out. If a wait ever
+/// fills the buffers, they're doubled up to `MAX_EVENTS`.
+const INITIAL_EVENTS: usize = 64;
+const MAX_EVENTS: usize = 64 * 1024;
+
+/// Sets the number of epoll threads used to drive async sockets. Each socket is assigned to one of
+/// the threads by hash, and each thread keeps its own wakers, so more threads means less
+/// contention when there are many busy sockets. Defaults to 1.
+///
+/// The reactor is created along with the first async socket and is only torn down once no SRT
+/// sockets of any kind are open, so this only takes effect the next time that happens.
+pub fn set_epoll_reactor_threads(threads: usize) {
+    THREADS.store(threads.max(1), Ordering::Relaxed);
+}
+
 #[derive(Default)]
 struct Wakers {
     read_waker: Option<Waker>,
@@ -17,10 +38,7 @@ struct Wakers {
 }
 
 pub(crate) struct EpollReactor {
-    eid: int,
-    join_handle: Option<thread::JoinHandle<()>>,
-    pipe: UnixStream,
-    wakers: Arc<Mutex<HashMap<sys::SRTSOCKET, Wakers>>>,
+    shards: Vec<Shard>,
 }
 
 pub const READ_EVENTS: int = sys::SRT_EPOLL_OPT_SRT_EPOLL_ERR as int | sys::SRT_EPOLL_OPT_SRT_EPOLL_IN as int;
@@ -29,6 +47,49 @@ pub const READ_WRITE_EVENTS: int = READ_EVENTS | WRITE_EVENTS;
 
 impl EpollReactor {
     pub fn new() -> Result<Self> {
+        Self::with_threads(THREADS.load(Ordering::Relaxed))
+    }
+
+    fn with_threads(threads: usize) -> Result<Self> {
+        Ok(Self {
+            shards: (0..threads.max(1)).map(|_| Shard::new()).collect::<Result<_>>()?,
+        })
+    }
+
+    fn shard(&self, s: sys::SRTSOCKET) -> &Shard {
+        &self.shards[shard_index(s, self.shards.len())]
+    }
+
+    pub fn wake_when_read_ready(&self, s: &Socket, waker: Waker) {
+        self.shard(s.raw()).wake_when_read_ready(s.raw(), waker)
+    }
+
+    pub fn wake_when_write_ready(&self, s: &Socket, waker: Waker) {
+        self.shard(s.raw()).wake_when_write_ready(s.raw(), waker)
+    }
+
+    pub fn remove_socket(&self, s: &Socket) {
+        self.shard(s.raw()).remove_socket(s.raw())
+    }
+}
+
+/// SRT allocates socket ids sequentially, so they're mixed with a multiplicative hash before being
+/// mapped onto the shards.
+fn shard_index(s: sys::SRTSOCKET, shards: usize) -> usize {
+    let hash = (s as u32).wrapping_mul(0x9e37_79b9);
+    ((hash as u64 * shards as u64) >> 32) as usize
+}
+
+/// A single epoll thread along with the wakers for the sockets assigned to it.
+struct Shard {
+    eid: int,
+    join_handle: Option<thread::JoinHandle<()>>,
+    pipe: UnixStream,
+    wakers: Arc<Mutex<HashMap<sys::SRTSOCKET, Wakers>>>,
+}
+
+impl Shard {
+    fn new() -> Result<Self> {
         let eid = match unsafe { sys::srt_epoll_create() } {
             -1 => return Err(new_srt_error("srt_epoll_create")),
             id => id,
@@ -43,8 +104,7 @@ impl EpollReactor {
         })
     }
 
-    pub fn wake_when_read_ready(&self, s: &Socket, waker: Waker) {
-        let s = s.raw();
+    fn wake_when_read_ready(&self, s: sys::SRTSOCKET, waker: Waker) {
         let mut wakers = self.wakers.lock().expect("the lock should not be poisoned");
         match wakers.get_mut(&s) {
             Some(prev) => {
@@ -67,8 +127,7 @@ impl EpollReactor {
         }
     }
 
-    pub fn wake_when_write_ready(&self, s: &Socket, waker: Waker) {
-        let s = s.raw();
+    fn wake_when_write_ready(&self, s: sys::SRTSOCKET, waker: Waker) {
         let mut wakers = self.wakers.lock().expect("the lock should not be poisoned");
         match wakers.get_mut(&s) {
             Some(prev) => {
@@ -91,8 +150,7 @@ impl EpollReactor {
         }
     }
 
-    pub fn remove_socket(&self, s: &Socket) {
-        let s = s.raw();
+    fn remove_socket(&self, s: sys::SRTSOCKET) {
         let mut wakers = self.wakers.lock().expect("the lock should not be poisoned");
         if wakers.remove(&s).is_some() {
             unsafe { sys::srt_epoll_remove_usock(self.eid, s) };
@@ -102,18 +160,19 @@ impl EpollReactor {
     fn run(eid: int, wakers: Arc<Mutex<HashMap<sys::SRTSOCKET, Wakers>>>, pipe: UnixStream) {
         unsafe { sys::srt_epoll_add_ssock(eid, pipe.into_raw_fd(), &READ_EVENTS) };
 
-        let mut readfds = [0; 200];
-        let mut writefds = [0; 200];
+        let mut readfds = vec![0; INITIAL_EVENTS];
+        let mut writefds = vec![0; INITIAL_EVENTS];
         let mut sys_readfds = [0; 1];
         let mut sys_writefds = [0; 1];
         let mut removed = HashSet::new();
+        let mut ready = Vec::new();
 
         loop {
             let mut rnum = readfds.len() as int;
             let mut wnum = writefds.len() as int;
             let mut lrnum = sys_readfds.len() as int;
             let mut lwnum = sys_writefds.len() as int;
-            unsafe {
+            let ret = unsafe {
                 sys::srt_epoll_wait(
                     eid,
                     readfds.as_mut_ptr(),
@@ -128,6 +187,15 @@ impl EpollReactor {
                 )
             };
 
+            // The counts are only updated when something is ready, which is the only way the wait
+            // returns successfully without a timeout. It can only fail if the epoll id is no longer
+            // usable, in which case there's nothing left to do.
+            match ret {
+                ret if ret < 0 => return,
+                0 => continue,
+                _ => {}
+            }
+
             if lrnum > 0 {
                 return;
             }
@@ -140,7 +208,7 @@ impl EpollReactor {
                     match wakers.get_mut(&fd) {
                         Some(fd_wakers) => {
                             if let Some(waker) = fd_wakers.read_waker.take() {
-                                waker.wake();
+                                ready.push(waker);
                             }
                             if fd_wakers.write_waker.is_some() {
                                 unsafe { sys::srt_epoll_update_usock(eid, fd, &WRITE_EVENTS) };
@@ -161,7 +229,7 @@ impl EpollReactor {
                     match wakers.get_mut(&fd) {
                         Some(fd_wakers) => {
                             if let Some(waker) = fd_wakers.write_waker.take() {
-                                waker.wake();
+                                ready.push(waker);
                             }
                             if fd_wakers.read_waker.is_some() {
                                 unsafe { sys::srt_epoll_update_usock(eid, fd, &READ_EVENTS) };
@@ -180,12 +248,28 @@ impl EpollReactor {
                         }
                     }
                 }
+
+                // Wake the tasks without holding the lock so that they can immediately register
+                // again without waiting on us.
+                mem::drop(wakers);
+                for waker in ready.drain(..) {
+                    waker.wake();
+                }
+            }
+
+            // SRT truncates the results to fit the buffers, leaving the rest to be reported by
+            // the next wait. If we're hitting that, make room for more.
+            if rnum as usize >= readfds.len() && readfds.len() < MAX_EVENTS {
+                readfds.resize(readfds.len() * 2, 0);
+            }
+            if wnum as usize >= writefds.len() && writefds.len() < MAX_EVENTS {
+                writefds.resize(writefds.len() * 2, 0);
             }
         }
     }
 }
 
-impl Drop for EpollReactor {
+impl Drop for Shard {
     fn drop(&mut self) {
         let _ = self.pipe.write(b"x").expect("we should be able to write to the epoll thread pipe");
         self.join_handle
@@ -206,5 +290,24 @@ mod test {
     fn test_epoll_reactor() {
         let reactor = EpollReactor::new();
         std::mem::drop(reactor);
+
+        let reactor = EpollReactor::with_threads(4).unwrap();
+        assert_eq!(reactor.shards.len(), 4);
+        std::mem::drop(reactor);
+    }
+
+    #[test]
+    fn test_shard_index() {
+        let mut counts = [0; 4];
+        for s in 1_000_000..1_004_000 {
+            counts[shard_index(s, counts.len())] += 1;
+        }
+        for &count in &counts {
+            assert!((900..1100).contains(&count), "{:?}", counts);
+        }
+
+        for s in 0..1000 {
+            assert_eq!(shard_index(s, 1), 0);
+        }
     }
 }
@@ -19,6 +19,8 @@ mod async_lib;
 mod epoll_reactor;
 #[cfg(feature = "async")]
 pub use async_lib::*;
+#[cfg(feature = "async")]
+pub use epoll_reactor::set_epoll_reactor_threads;
 
 #[derive(Debug)]
 pub enum Error {
@@ -259,6 +261,9 @@ impl Socket {
         if let Some(v) = &options.send_buffer_size {
             self.set(sys::SRT_SOCKOPT_SRTO_SNDBUF, *v)?;
         }
+        if let Some(v) = &options.batched_io {
+            self.set(sys::SRT_SOCKOPT_SRTO_BATCHEDIO, *v)?;
+        }
         if let Some(v) = &options.max_bandwidth {
             match v {
                 MaxBandwidth::Infinite => self.set(sys::SRT_SOCKOPT_SRTO_MAXBW, -1i64)?,
@@ -393,6 +398,9 @@ pub enum ListenerOption {
     TooLatePacketDrop(bool),
     ReceiveBufferSize(i32),
     SendBufferSize(i32),
+    /// Sends and receives UDP packets in batches with sendmmsg/recvmmsg. This requires the
+    /// "batched-io" feature and is only supported on Linux.
+    BatchedIo(bool),
 }
 
 impl ListenerOption {
@@ -402,6 +410,7 @@ impl ListenerOption {
             ListenerOption::TooLatePacketDrop(v) => sock.set(sys::SRT_SOCKOPT_SRTO_TLPKTDROP, *v),
             ListenerOption::ReceiveBufferSize(v) => sock.set(sys::SRT_SOCKOPT_SRTO_RCVBUF, *v),
             ListenerOption::SendBufferSize(v) => sock.set(sys::SRT_SOCKOPT_SRTO_SNDBUF, *v),
+            ListenerOption::BatchedIo(v) => sock.set(sys::SRT_SOCKOPT_SRTO_BATCHEDIO, *v),
         }
     }
 }
@@ -483,6 +492,8 @@ pub struct ConnectOptions {
     pub receive_buffer_size: Option<i32>,
     pub send_buffer_size: Option<i32>,
     pub max_bandwidth: Option<MaxBandwidth>,
+    /// See `ListenerOption::BatchedIo`.
+    pub batched_io: Option<bool>,
 }
 
 impl Stream {
@@ -599,6 +610,38 @@ mod test {
         server_thread.join().unwrap();
     }
 
+    #[cfg(feature = "batched-io")]
+    #[test]
+    fn test_batched_io() {
+        const PACKETS: usize = 1000;
+
+        let server_thread = thread::spawn(|| {
+            let listener = Listener::bind_with_options(
+                "127.0.0.1:1239",
+                [ListenerOption::BatchedIo(true), ListenerOption::TooLatePacketDrop(false)].iter().cloned(),
+            )
+            .unwrap();
+            let (mut conn, _) = listener.accept().unwrap();
+            let mut buf = [0; 1316];
+            for i in 0..PACKETS {
+                assert_eq!(conn.read(&mut buf).unwrap(), buf.len());
+                assert!(buf.iter().all(|&b| b == i as u8));
+            }
+        });
+
+        let options = ConnectOptions {
+            batched_io: Some(true),
+            too_late_packet_drop: Some(false),
+            ..Default::default()
+        };
+        let mut conn = Stream::connect("127.0.0.1:1239", &options).unwrap();
+        for i in 0..PACKETS {
+            assert_eq!(conn.write(&[i as u8; 1316]).unwrap(), 1316);
+        }
+
+        server_thread.join().unwrap();
+    }
+
     #[test]
     fn test_to_sockaddr() {
         let addr: SocketAddr = "127.0.0.1:8080".parse().unwrap();
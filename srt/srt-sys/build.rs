@@ -5,6 +5,10 @@ fn main() {
     let mut build = cmake::Config::new("vendor/srt-1.4.4");
     build.define("ENABLE_APPS", "OFF").define("ENABLE_SHARED", "OFF");
 
+    if std::env::var("CARGO_FEATURE_BATCHED_IO").is_ok() {
+        build.define("ENABLE_BATCHED_IO", "ON");
+    }
+
     if target_os == "macos" {
         build.define(
             "CMAKE_OSX_ARCHITECTURES",
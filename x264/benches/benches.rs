@@ -0,0 +1,139 @@
+use av_traits::{EncodedFrameType, PipelinedVideoEncoder, RawVideoFrame, VideoEncoder};
+use criterion::{criterion_group, criterion_main, BenchmarkId, Criterion, Throughput};
+use std::{
+    alloc::{GlobalAlloc, Layout, System},
+    sync::atomic::{AtomicU64, Ordering},
+    time::{Duration, Instant},
+};
+use x264::{X264Encoder, X264EncoderConfig, X264EncoderInputFormat};
+
+const WIDTH: usize = 1920;
+const HEIGHT: usize = 1080;
+
+/// Counts heap allocations so that the benchmarks can report them per frame. Only Rust's
+/// allocations are seen: x264 allocates its own buffers up front.
+struct CountingAllocator;
+
+static ALLOCATIONS: AtomicU64 = AtomicU64::new(0);
+
+unsafe impl GlobalAlloc for CountingAllocator {
+    unsafe fn alloc(&self, layout: Layout) -> *mut u8 {
+        ALLOCATIONS.fetch_add(1, Ordering::Relaxed);
+        System.alloc(layout)
+    }
+
+    unsafe fn dealloc(&self, ptr: *mut u8, layout: Layout) {
+        System.dealloc(ptr, layout)
+    }
+
+    unsafe fn realloc(&self, ptr: *mut u8, layout: Layout, new_size: usize) -> *mut u8 {
+        ALLOCATIONS.fetch_add(1, Ordering::Relaxed);
+        System.realloc(ptr, layout, new_size)
+    }
+}
+
+#[global_allocator]
+static GLOBAL: CountingAllocator = CountingAllocator;
+
+struct Frame {
+    planes: [Vec<u8>; 3],
+}
+
+impl RawVideoFrame<u8> for Frame {
+    fn samples(&self, plane: usize) -> &[u8] {
+        &self.planes[plane]
+    }
+}
+
+/// Raw frames are recycled the same way for both APIs, so that any difference in allocations
+/// comes from the encoder.
+#[derive(Default)]
+struct FramePool {
+    frames: Vec<Frame>,
+    frame_count: usize,
+}
+
+impl FramePool {
+    /// Returns a frame with a gradient and a line that moves from top to bottom.
+    fn take(&mut self) -> Frame {
+        let mut frame = self.frames.pop().unwrap_or_else(|| Frame {
+            planes: [vec![0; WIDTH * HEIGHT], vec![200; WIDTH * HEIGHT / 4], vec![128; WIDTH * HEIGHT / 4]],
+        });
+        for (line, row) in frame.planes[0].chunks_mut(WIDTH).enumerate() {
+            let sample = if line / 12 == self.frame_count % 90 {
+                16
+            } else {
+                (16.0 + (line as f64 / HEIGHT as f64) * 219.0).round() as u8
+            };
+            row.fill(sample);
+        }
+        self.frame_count += 1;
+        frame
+    }
+
+    fn recycle(&mut self, frame: Frame) {
+        self.frames.push(frame);
+    }
+}
+
+fn new_encoder() -> X264Encoder<Frame> {
+    X264Encoder::new(X264EncoderConfig {
+        width: WIDTH as _,
+        height: HEIGHT as _,
+        bitrate: Some(5_000_000),
+        fps: 29.97,
+        input_format: X264EncoderInputFormat::Yuv420Planar,
+    })
+    .unwrap()
+}
+
+/// Times `encode_frame` and tallies the allocations it makes. The tally includes warm-up, which
+/// is when the frame pool and encoder buffers fill up, so it's slightly pessimistic.
+fn bench_encoder<E: FnMut(&mut X264Encoder<Frame>, &mut FramePool)>(c: &mut Criterion, name: &str, mut encode_frame: E) {
+    let mut group = c.benchmark_group("x264_1080p");
+    group.sample_size(10);
+    group.throughput(Throughput::Elements(1));
+
+    let mut encoder = new_encoder();
+    let mut frames = FramePool::default();
+    let mut allocations = 0;
+    let mut frame_count = 0;
+    group.bench_function(BenchmarkId::from_parameter(name), |b| {
+        b.iter_custom(|iters| {
+            let mut elapsed = Duration::default();
+            for _ in 0..iters {
+                let before = ALLOCATIONS.load(Ordering::Relaxed);
+                let start = Instant::now();
+                encode_frame(&mut encoder, &mut frames);
+                elapsed += start.elapsed();
+                allocations += ALLOCATIONS.load(Ordering::Relaxed) - before;
+            }
+            frame_count += iters;
+            elapsed
+        })
+    });
+    group.finish();
+
+    println!("x264_1080p/{}: {:.2} allocations/frame", name, allocations as f64 / frame_count.max(1) as f64);
+}
+
+fn criterion_benchmark(c: &mut Criterion) {
+    bench_encoder(c, "encode", |encoder, frames| {
+        let frame = frames.take();
+        if let Some(output) = encoder.encode(frame, EncodedFrameType::Auto).unwrap() {
+            frames.recycle(output.raw_frame);
+        }
+    });
+
+    bench_encoder(c, "pipelined", |encoder, frames| {
+        let frame = frames.take();
+        encoder.submit(frame, EncodedFrameType::Auto).unwrap();
+        while let Some(output) = encoder.receive().unwrap() {
+            frames.recycle(output.raw_frame);
+            encoder.recycle(output.encoded_frame);
+        }
+    });
+}
+
+criterion_group!(benches, criterion_benchmark);
+criterion_main!(benches);
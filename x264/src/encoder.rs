@@ -1,6 +1,6 @@
-use av_traits::{EncodedFrameType, EncodedVideoFrame, RawVideoFrame, VideoEncoder, VideoEncoderOutput};
+use av_traits::{EncodedFrameType, EncodedVideoFrame, EncodedVideoFramePool, PipelinedVideoEncoder, RawVideoFrame, VideoEncoder, VideoEncoderOutput};
 use snafu::Snafu;
-use std::{marker::PhantomData, mem};
+use std::{collections::VecDeque, mem};
 use x264_sys as sys;
 
 #[derive(Debug, Snafu)]
@@ -15,8 +15,16 @@ pub struct X264Encoder<F> {
     encoder: *mut sys::x264_t,
     frame_count: u64,
 
-    // raw frames are sent to the c library and stored there during encoding
-    frame: PhantomData<F>,
+    // Raw frames are held here while the c library encodes them, and each picture's opaque
+    // pointer holds the index of its frame. Freed slots are reused, so once the encoder's delay
+    // is filled no more allocations are needed.
+    frames: Vec<Option<F>>,
+    free_frames: Vec<usize>,
+
+    // Output that has been encoded, but not yet received.
+    output: VecDeque<VideoEncoderOutput<F>>,
+    pool: EncodedVideoFramePool,
+    finished: bool,
 }
 
 impl<F> Drop for X264Encoder<F> {
@@ -90,7 +98,11 @@ impl<F> X264Encoder<F> {
                     config,
                     encoder,
                     frame_count: 0,
-                    frame: PhantomData,
+                    frames: Vec::new(),
+                    free_frames: Vec::new(),
+                    output: VecDeque::new(),
+                    pool: EncodedVideoFramePool::new(),
+                    finished: false,
                 })
             }
         }
@@ -119,14 +131,16 @@ impl<F> X264Encoder<F> {
                 0 => Ok(None),
                 nal_bytes if nal_bytes < 0 => Err(X264EncoderError::Unknown),
                 nal_bytes => {
-                    let input: Box<F> = Box::from_raw(pic_out.opaque as _);
+                    let index = pic_out.opaque as usize;
+                    let input = self.frames[index].take().ok_or(X264EncoderError::Unknown)?;
+                    self.free_frames.push(index);
                     let nals = std::slice::from_raw_parts(nals, nal_count as _);
-                    let mut data = Vec::with_capacity(nal_bytes as _);
+                    let mut data = self.pool.take(nal_bytes as _);
                     for nal in nals {
                         data.extend_from_slice(std::slice::from_raw_parts(nal.p_payload, nal.i_payload as _));
                     }
                     Ok(Some(VideoEncoderOutput {
-                        raw_frame: *input,
+                        raw_frame: input,
                         encoded_frame: EncodedVideoFrame {
                             data,
                             is_keyframe: pic_out.b_keyframe != 0,
@@ -143,12 +157,37 @@ impl<F: RawVideoFrame<u8>> VideoEncoder for X264Encoder<F> {
     type RawVideoFrame = F;
 
     fn encode(&mut self, input: F, frame_type: EncodedFrameType) -> Result<Option<VideoEncoderOutput<F>>> {
+        self.submit(input, frame_type)?;
+        Ok(self.output.pop_front())
+    }
+
+    fn flush(&mut self) -> Result<Option<VideoEncoderOutput<F>>> {
+        self.finish()?;
+        self.receive()
+    }
+}
+
+impl<F: RawVideoFrame<u8>> PipelinedVideoEncoder for X264Encoder<F> {
+    fn submit(&mut self, input: F, frame_type: EncodedFrameType) -> Result<()> {
+        let index = match self.free_frames.pop() {
+            Some(index) => {
+                self.frames[index] = Some(input);
+                index
+            }
+            None => {
+                self.frames.push(Some(input));
+                self.frames.len() - 1
+            }
+        };
+        // The planes only need to remain valid for the duration of the encode call since x264
+        // copies them into its own buffers.
+        let input = self.frames[index].as_ref().expect("the frame was just inserted");
+
         let mut pic = unsafe {
             let mut pic: mem::MaybeUninit<sys::x264_picture_t> = mem::MaybeUninit::uninit();
             sys::x264_picture_init(pic.as_mut_ptr());
             pic.assume_init()
         };
-        let input = Box::new(input);
         pic.img.i_csp = self.config.input_format.csp();
         match self.config.input_format {
             X264EncoderInputFormat::Yuv420Planar => {
@@ -166,18 +205,43 @@ impl<F: RawVideoFrame<u8>> VideoEncoder for X264Encoder<F> {
                 }
             }
         }
-        pic.opaque = Box::into_raw(input) as _;
+        pic.opaque = index as _;
         pic.i_pts = self.frame_count as _;
         pic.i_type = match frame_type {
             EncodedFrameType::Auto => sys::X264_TYPE_AUTO as _,
             EncodedFrameType::Key => sys::X264_TYPE_KEYFRAME as _,
         };
         self.frame_count += 1;
-        self.do_encode(Some(pic))
+        // If this fails, x264 may have queued the picture anyway and hand it back later, so its
+        // slot is left occupied rather than freed for reuse. It's released when the picture comes
+        // back out, or when the encoder is dropped.
+        if let Some(output) = self.do_encode(Some(pic))? {
+            self.output.push_back(output);
+        }
+        Ok(())
     }
 
-    fn flush(&mut self) -> Result<Option<VideoEncoderOutput<F>>> {
-        self.do_encode(None)
+    fn receive(&mut self) -> Result<Option<VideoEncoderOutput<F>>> {
+        if let Some(output) = self.output.pop_front() {
+            return Ok(Some(output));
+        }
+        if self.finished {
+            while unsafe { sys::x264_encoder_delayed_frames(self.encoder) } > 0 {
+                if let Some(output) = self.do_encode(None)? {
+                    return Ok(Some(output));
+                }
+            }
+        }
+        Ok(None)
+    }
+
+    fn finish(&mut self) -> Result<()> {
+        self.finished = true;
+        Ok(())
+    }
+
+    fn recycle(&mut self, frame: EncodedVideoFrame) {
+        self.pool.recycle(frame);
     }
 }
 
@@ -244,6 +308,82 @@ mod test {
         //std::fs::File::create("tmp.h264").unwrap().write_all(&encoded).unwrap();
     }
 
+    #[test]
+    fn test_pipelined_video_encoder() {
+        let new_encoder = || {
+            X264Encoder::new(X264EncoderConfig {
+                width: 1920,
+                height: 1080,
+                bitrate: Some(10000),
+                fps: 29.97,
+                input_format: X264EncoderInputFormat::Yuv420Planar,
+            })
+            .unwrap()
+        };
+        let u = vec![200u8; 1920 * 1080 / 4];
+        let v = vec![128u8; 1920 * 1080 / 4];
+        let frames: Vec<_> = (0..90)
+            .map(|i| {
+                let mut y = Vec::with_capacity(1920 * 1080);
+                for line in 0..1080 {
+                    let sample = if line / 12 == i {
+                        16
+                    } else {
+                        (16.0 + (line as f64 / 1080.0) * 219.0).round() as u8
+                    };
+                    y.resize(y.len() + 1920, sample);
+                }
+                y
+            })
+            .collect();
+
+        let mut expected = vec![];
+        {
+            let mut encoder = new_encoder();
+            for y in &frames {
+                let frame = TestFrame {
+                    samples: vec![y.clone(), u.clone(), v.clone()],
+                };
+                if let Some(mut output) = encoder.encode(frame, EncodedFrameType::Auto).unwrap() {
+                    expected.append(&mut output.encoded_frame.data);
+                }
+            }
+            while let Some(mut output) = encoder.flush().unwrap() {
+                expected.append(&mut output.encoded_frame.data);
+            }
+        }
+
+        let mut encoder = new_encoder();
+        let mut encoded = vec![];
+        let mut raw_frames = vec![];
+        let mut receive = |encoder: &mut X264Encoder<TestFrame>| {
+            while let Some(output) = encoder.receive().unwrap() {
+                encoded.extend_from_slice(&output.encoded_frame.data);
+                raw_frames.push(output.raw_frame);
+                encoder.recycle(output.encoded_frame);
+            }
+        };
+        for y in &frames {
+            let frame = TestFrame {
+                samples: vec![y.clone(), u.clone(), v.clone()],
+            };
+            encoder.submit(frame, EncodedFrameType::Auto).unwrap();
+            receive(&mut encoder);
+        }
+        encoder.finish().unwrap();
+        receive(&mut encoder);
+
+        assert_eq!(encoded, expected);
+        assert_eq!(raw_frames.len(), 90);
+        for (frame, y) in raw_frames.iter().zip(&frames) {
+            assert_eq!(&frame.samples[0], y);
+        }
+
+        // every frame was received right away, so a single buffer should have been reused
+        assert_eq!(encoder.pool.len(), 1);
+        assert!(encoder.frames.iter().all(|f| f.is_none()));
+    }
+
     #[test]
     fn test_video_encoder_with_encode_frame_type() {
         let mut encoder = X264Encoder::new(X264EncoderConfig {